@@ -14,6 +14,8 @@
 	Lesser General Public License for more details.
 */
 
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include <libloc/as.h>
@@ -23,14 +25,73 @@
 
 struct loc_as_list {
 	struct loc_ctx* ctx;
-	int refcount;
+	atomic_int refcount;
 
 	struct loc_as** elements;
 	size_t elements_size;
 
 	size_t size;
+
+	// Hash table of all AS numbers in the list (zero marks an empty slot)
+	uint32_t* numbers;
+	unsigned int numbers_bits;
+
+	// AS0 cannot be stored in the hash table
+	int zero;
 };
 
+static size_t loc_as_list_hash(const struct loc_as_list* list, uint32_t number) {
+	// Use the high bits because the low bits only depend on the low bits of number
+	return (uint32_t)(number * 2654435761u) >> (32 - list->numbers_bits);
+}
+
+/*
+	Returns the slot of number in the hash table, or the empty slot where it belongs
+*/
+static uint32_t* loc_as_list_find_number(const struct loc_as_list* list, uint32_t number) {
+	const size_t mask = ((size_t)1 << list->numbers_bits) - 1;
+	size_t i = loc_as_list_hash(list, number);
+
+	while (list->numbers[i] && list->numbers[i] != number)
+		i = (i + 1) & mask;
+
+	return &list->numbers[i];
+}
+
+/*
+	Makes the hash table large enough to hold one more AS while it
+	stays at most half full
+*/
+static int loc_as_list_grow_numbers(struct loc_as_list* list) {
+	const size_t numbers_size = (list->numbers) ? (size_t)1 << list->numbers_bits : 0;
+
+	if ((list->size + 1) * 2 <= numbers_size)
+		return 0;
+
+	uint32_t* numbers = list->numbers;
+	const unsigned int numbers_bits = list->numbers_bits;
+
+	list->numbers_bits = (numbers) ? numbers_bits + 1 : 6;
+
+	list->numbers = calloc((size_t)1 << list->numbers_bits, sizeof(*list->numbers));
+	if (!list->numbers) {
+		list->numbers = numbers;
+		list->numbers_bits = numbers_bits;
+		return 1;
+	}
+
+	// Insert all numbers again
+	for (size_t i = 0; i < numbers_size; i++) {
+		if (numbers[i])
+			*loc_as_list_find_number(list, numbers[i]) = numbers[i];
+	}
+
+	if (numbers)
+		free(numbers);
+
+	return 0;
+}
+
 static int loc_as_list_grow(struct loc_as_list* list) {
 	size_t size = list->elements_size * 2;
 	if (size < 1024)
@@ -111,6 +172,12 @@ LOC_EXPORT void loc_as_list_clear(struct loc_as_list* list) {
 	list->elements_size = 0;
 
 	list->size = 0;
+
+	if (list->numbers)
+		free(list->numbers);
+	list->numbers = NULL;
+	list->numbers_bits = 0;
+	list->zero = 0;
 }
 
 LOC_EXPORT struct loc_as* loc_as_list_get(struct loc_as_list* list, size_t index) {
@@ -133,35 +200,39 @@ LOC_EXPORT int loc_as_list_append(
 			return r;
 	}
 
+	int r = loc_as_list_grow_numbers(list);
+	if (r)
+		return r;
+
 	DEBUG(list->ctx, "%p: Appending AS %p to list\n", list, as);
 
 	list->elements[list->size++] = loc_as_ref(as);
 
+	const uint32_t number = loc_as_get_number(as);
+
+	// Remember the number
+	if (number)
+		*loc_as_list_find_number(list, number) = number;
+	else
+		list->zero = 1;
+
 	return 0;
 }
 
 LOC_EXPORT int loc_as_list_contains(
 		struct loc_as_list* list, struct loc_as* as) {
-	for (unsigned int i = 0; i < list->size; i++) {
-		if (loc_as_cmp(as, list->elements[i]) == 0)
-			return 1;
-	}
-
-	return 0;
+	return loc_as_list_contains_number(list, loc_as_get_number(as));
 }
 
 LOC_EXPORT int loc_as_list_contains_number(
 		struct loc_as_list* list, uint32_t number) {
-	struct loc_as* as;
-
-	int r = loc_as_new(list->ctx, &as, number);
-	if (r)
-		return -1;
+	if (!number)
+		return list->zero;
 
-	r = loc_as_list_contains(list, as);
-	loc_as_unref(as);
+	if (!list->numbers)
+		return 0;
 
-	return r;
+	return *loc_as_list_find_number(list, number) != 0;
 }
 
 static int __loc_as_cmp(const void* as1, const void* as2) {
@@ -16,6 +16,7 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -33,10 +34,13 @@
 
 struct loc_as {
 	struct loc_ctx* ctx;
-	int refcount;
+	atomic_int refcount;
 
 	uint32_t number;
 	char* name;
+
+	// Objects that are shared by a database cannot be changed
+	int readonly;
 };
 
 LOC_EXPORT int loc_as_new(struct loc_ctx* ctx, struct loc_as** as, uint32_t number) {
@@ -90,6 +94,11 @@ LOC_EXPORT const char* loc_as_get_name(struct loc_as* as) {
 }
 
 LOC_EXPORT int loc_as_set_name(struct loc_as* as, const char* name) {
+	if (as->readonly) {
+		errno = EPERM;
+		return 1;
+	}
+
 	if (as->name)
 		free(as->name);
 
@@ -111,6 +120,10 @@ LOC_EXPORT int loc_as_cmp(struct loc_as* as1, struct loc_as* as2) {
 	return 0;
 }
 
+void loc_as_set_readonly(struct loc_as* as) {
+	as->readonly = 1;
+}
+
 int loc_as_new_from_database_v1(struct loc_ctx* ctx, struct loc_stringpool* pool,
 		struct loc_as** as, const struct loc_database_as_v1* dbobj) {
 	uint32_t number = be32toh(dbobj->number);
@@ -0,0 +1,1103 @@
+/*
+	libloc - A library to determine the location of someone on the Internet
+
+	Copyright (C) 2024 IPFire Development Team <info@ipfire.org>
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+*/
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libloc/libloc.h>
+#include <libloc/address.h>
+#include <libloc/as.h>
+#include <libloc/as-list.h>
+#include <libloc/country.h>
+#include <libloc/country-list.h>
+#include <libloc/database.h>
+#include <libloc/network.h>
+
+#include "test.h"
+
+#define DEFAULT_COUNT 1000000
+#define BATCH_SIZE 256
+
+// The number of distinct addresses in the Zipf set
+#define ZIPF_ADDRESSES (1 << 16)
+
+static const char* path = ABS_SRCDIR "/data/database.db";
+static size_t count = DEFAULT_COUNT;
+static unsigned int max_threads = 1;
+
+/*
+	The different ways to look up addresses
+*/
+static struct engine {
+	const char* name;
+	int flags;
+	int validate;
+	struct loc_database* db;
+} engines[] = {
+	{ "tree",           0,                   0, NULL },
+	{ "validated tree", 0,                   1, NULL },
+	{ "stride index",   LOC_DB_INDEX_STRIDE, 0, NULL },
+	{ "DIR-24-8",       LOC_DB_INDEX_DIR24,  0, NULL },
+	{ NULL },
+};
+
+/*
+	A set of addresses to look up
+*/
+struct set {
+	const char* name;
+	struct in6_addr* addresses;
+	size_t count;
+	int family;
+};
+
+static int random_set(struct set* set, const char* name, int family) {
+	set->addresses = calloc(count, sizeof(*set->addresses));
+	if (!set->addresses)
+		return 1;
+
+	// Use the same addresses every time
+	srandom(1);
+
+	for (size_t i = 0; i < count; i++)
+		random_address(&set->addresses[i], family);
+
+	set->name = name;
+	set->count = count;
+	set->family = family;
+
+	return 0;
+}
+
+/*
+	Draws addresses from a fixed pool of random IPv4 addresses so that the
+	k-th address occurs with a probability proportional to 1/k
+*/
+static int zipf_set(struct set* set, const char* name) {
+	struct in6_addr* pool = NULL;
+	double* cdf = NULL;
+	double sum = 0;
+	int r = 1;
+
+	pool = calloc(ZIPF_ADDRESSES, sizeof(*pool));
+	if (!pool)
+		goto ERROR;
+
+	cdf = calloc(ZIPF_ADDRESSES, sizeof(*cdf));
+	if (!cdf)
+		goto ERROR;
+
+	set->addresses = calloc(count, sizeof(*set->addresses));
+	if (!set->addresses)
+		goto ERROR;
+
+	// Use the same addresses every time
+	srandom(1);
+
+	for (unsigned int i = 0; i < ZIPF_ADDRESSES; i++) {
+		random_address(&pool[i], AF_INET);
+
+		sum += 1.0 / (i + 1);
+		cdf[i] = sum;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		double x = sum * random() / ((double)RAND_MAX + 1);
+
+		// Find the first address whose cumulative weight exceeds x
+		unsigned int lo = 0;
+		unsigned int hi = ZIPF_ADDRESSES - 1;
+
+		while (lo < hi) {
+			unsigned int mid = (lo + hi) / 2;
+
+			if (cdf[mid] > x)
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+
+		set->addresses[i] = pool[lo];
+	}
+
+	set->name = name;
+	set->count = count;
+	set->family = AF_INET;
+
+	r = 0;
+
+ERROR:
+	if (pool)
+		free(pool);
+	if (cdf)
+		free(cdf);
+
+	return r;
+}
+
+/*
+	Reads a trace with one address per line
+*/
+static int trace_set(struct set* set, const char* trace) {
+	struct in6_addr* addresses = NULL;
+	char* line = NULL;
+	size_t length = 0;
+	size_t size = 0;
+	int r = 1;
+
+	FILE* f = fopen(trace, "r");
+	if (!f) {
+		fprintf(stderr, "Could not open %s: %m\n", trace);
+		return 1;
+	}
+
+	set->name = trace;
+	set->addresses = NULL;
+	set->count = 0;
+	set->family = AF_INET;
+
+	while (getline(&line, &length, f) > 0) {
+		// Remove the trailing newline
+		line[strcspn(line, "\r\n")] = '\0';
+
+		// Skip empty lines
+		if (!*line)
+			continue;
+
+		// Make space
+		if (set->count == size) {
+			size = size ? size * 2 : 1024;
+
+			addresses = reallocarray(set->addresses, size, sizeof(*addresses));
+			if (!addresses)
+				goto ERROR;
+
+			set->addresses = addresses;
+		}
+
+		r = loc_address_parse(&set->addresses[set->count], NULL, line);
+		if (r) {
+			fprintf(stderr, "Could not parse address: %s\n", line);
+			goto ERROR;
+		}
+
+		// Only use the IPv4 lookup if the trace has no IPv6 addresses
+		if (!IN6_IS_ADDR_V4MAPPED(&set->addresses[set->count]))
+			set->family = AF_INET6;
+
+		set->count++;
+	}
+
+	if (!set->count) {
+		fprintf(stderr, "%s does not contain any addresses\n", trace);
+		r = 1;
+		goto ERROR;
+	}
+
+	r = 0;
+
+ERROR:
+	if (line)
+		free(line);
+	fclose(f);
+
+	return r;
+}
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char* name, const struct set* set, double t, size_t found) {
+	printf("    %-25s %10.1f ns/lookup %8.2f M lookups/s (%zu/%zu found)\n",
+		name, t / set->count, set->count / t * 1e3, found, set->count);
+}
+
+static int cmp_latency(const void* p1, const void* p2) {
+	const double* t1 = p1;
+	const double* t2 = p2;
+
+	return (*t1 > *t2) - (*t1 < *t2);
+}
+
+static double percentile(const double* latencies, size_t length, double p) {
+	size_t i = length * p;
+
+	if (i >= length)
+		i = length - 1;
+
+	return latencies[i];
+}
+
+/*
+	Times every single call to loc_database_lookup() and reports the distribution.
+	The figures include the overhead of reading the clock.
+*/
+static int bench_latency(struct loc_database* db, const struct set* set) {
+	struct loc_network* network = NULL;
+	int r = 0;
+
+	double* latencies = calloc(set->count, sizeof(*latencies));
+	if (!latencies)
+		return 1;
+
+	for (size_t i = 0; i < set->count; i++) {
+		double t = now();
+
+		r = loc_database_lookup(db, &set->addresses[i], &network);
+
+		latencies[i] = now() - t;
+
+		if (r) {
+			fprintf(stderr, "Lookup failed: %m\n");
+			goto ERROR;
+		}
+
+		if (network)
+			loc_network_unref(network);
+	}
+
+	qsort(latencies, set->count, sizeof(*latencies), cmp_latency);
+
+	printf("    %-25s %10.0f ns p50, %.0f ns p99, %.0f ns p999\n", "",
+		percentile(latencies, set->count, 0.5),
+		percentile(latencies, set->count, 0.99),
+		percentile(latencies, set->count, 0.999));
+
+ERROR:
+	free(latencies);
+
+	return r;
+}
+
+static int bench_lookup(struct loc_database* db, const struct set* set) {
+	struct loc_network* network = NULL;
+	size_t found = 0;
+	int r;
+
+	double t = now();
+
+	for (size_t i = 0; i < set->count; i++) {
+		r = loc_database_lookup(db, &set->addresses[i], &network);
+		if (r) {
+			fprintf(stderr, "Lookup failed: %m\n");
+			return r;
+		}
+
+		if (network) {
+			loc_network_unref(network);
+			found++;
+		}
+	}
+
+	report("loc_database_lookup", set, now() - t, found);
+
+	return 0;
+}
+
+static int bench_cache_lookup(struct loc_database* db, const struct set* set) {
+	struct loc_database_cache* cache = NULL;
+	struct loc_network* network = NULL;
+	size_t found = 0;
+	int r;
+
+	r = loc_database_cache_new(&cache, db, 0, 24, 48);
+	if (r) {
+		fprintf(stderr, "Could not create cache: %m\n");
+		return r;
+	}
+
+	double t = now();
+
+	for (size_t i = 0; i < set->count; i++) {
+		r = loc_database_cache_lookup(cache, &set->addresses[i], &network);
+		if (r) {
+			fprintf(stderr, "Lookup failed: %m\n");
+			goto ERROR;
+		}
+
+		if (network) {
+			loc_network_unref(network);
+			found++;
+		}
+	}
+
+	report("loc_database_cache_lookup", set, now() - t, found);
+
+	printf("    %-25s %10.1f %% hits\n", "", 100.0 * loc_database_cache_hits(cache)
+		/ (loc_database_cache_hits(cache) + loc_database_cache_misses(cache)));
+
+ERROR:
+	loc_database_cache_unref(cache);
+
+	return r;
+}
+
+static int bench_lookup_info(struct loc_database* db, const struct set* set) {
+	struct loc_network_info info;
+	size_t found = 0;
+	int r;
+
+	double t = now();
+
+	for (size_t i = 0; i < set->count; i++) {
+		r = loc_database_lookup_info(db, &set->addresses[i], &info);
+		if (r) {
+			fprintf(stderr, "Lookup failed: %m\n");
+			return r;
+		}
+
+		if (info.family)
+			found++;
+	}
+
+	report("loc_database_lookup_info", set, now() - t, found);
+
+	return 0;
+}
+
+static int bench_lookup4(struct loc_database* db, const struct set* set) {
+	struct loc_network_info info;
+	size_t found = 0;
+	int r = 0;
+
+	uint32_t* addresses = calloc(set->count, sizeof(*addresses));
+	if (!addresses)
+		return 1;
+
+	for (size_t i = 0; i < set->count; i++)
+		addresses[i] = ntohl(set->addresses[i].s6_addr32[3]);
+
+	double t = now();
+
+	for (size_t i = 0; i < set->count; i++) {
+		r = loc_database_lookup4(db, addresses[i], &info);
+		if (r) {
+			fprintf(stderr, "Lookup failed: %m\n");
+			goto ERROR;
+		}
+
+		if (info.family)
+			found++;
+	}
+
+	report("loc_database_lookup4", set, now() - t, found);
+
+ERROR:
+	free(addresses);
+
+	return r;
+}
+
+static int bench_lookup_many(struct loc_database* db, const struct set* set) {
+	struct loc_network_info results[BATCH_SIZE];
+	size_t found = 0;
+	int r;
+
+	double t = now();
+
+	for (size_t i = 0; i < set->count; i += BATCH_SIZE) {
+		size_t length = set->count - i;
+		if (length > BATCH_SIZE)
+			length = BATCH_SIZE;
+
+		r = loc_database_lookup_many(db, &set->addresses[i], length, results);
+		if (r) {
+			fprintf(stderr, "Lookup failed: %m\n");
+			return r;
+		}
+
+		for (size_t j = 0; j < length; j++) {
+			if (results[j].family)
+				found++;
+		}
+	}
+
+	report("loc_database_lookup_many", set, now() - t, found);
+
+	return 0;
+}
+
+/*
+	Runs loc_database_lookup_info() on a slice of a set
+*/
+struct slice {
+	pthread_t thread;
+	struct loc_database* db;
+	const struct in6_addr* addresses;
+	size_t count;
+	size_t found;
+	int r;
+};
+
+static void* bench_slice(void* data) {
+	struct slice* slice = data;
+	struct loc_network_info info;
+
+	for (size_t i = 0; i < slice->count; i++) {
+		slice->r = loc_database_lookup_info(slice->db, &slice->addresses[i], &info);
+		if (slice->r)
+			break;
+
+		if (info.family)
+			slice->found++;
+	}
+
+	return NULL;
+}
+
+/*
+	Splits the set between an increasing number of threads which all share the
+	same database handle and reports the total throughput
+*/
+static int bench_threads(struct loc_database* db, const struct set* set) {
+	struct slice slices[max_threads];
+	size_t found;
+	int r;
+
+	for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+		double t = now();
+
+		for (unsigned int i = 0; i < threads; i++) {
+			size_t first = set->count * i / threads;
+			size_t last  = set->count * (i + 1) / threads;
+
+			slices[i] = (struct slice){
+				.db        = db,
+				.addresses = &set->addresses[first],
+				.count     = last - first,
+			};
+
+			r = pthread_create(&slices[i].thread, NULL, bench_slice, &slices[i]);
+			if (r) {
+				fprintf(stderr, "Could not create thread: %s\n", strerror(r));
+				return r;
+			}
+		}
+
+		found = 0;
+
+		for (unsigned int i = 0; i < threads; i++) {
+			pthread_join(slices[i].thread, NULL);
+
+			if (slices[i].r) {
+				fprintf(stderr, "Lookup failed\n");
+				return slices[i].r;
+			}
+
+			found += slices[i].found;
+		}
+
+		t = now() - t;
+
+		printf("    %2u thread(s) %23.2f M lookups/s (%zu/%zu found)\n",
+			threads, set->count / t * 1e3, found, set->count);
+	}
+
+	return 0;
+}
+
+static int bench(const struct set* set) {
+	int r;
+
+	printf("%s:\n", set->name);
+
+	for (struct engine* engine = engines; engine->name; engine++) {
+		// DIR-24-8 only makes a difference for IPv4
+		if ((engine->flags & LOC_DB_INDEX_DIR24) && set->family != AF_INET)
+			continue;
+
+		printf("  %s:\n", engine->name);
+
+		r = bench_lookup(engine->db, set);
+		if (r)
+			return r;
+
+		r = bench_latency(engine->db, set);
+		if (r)
+			return r;
+
+		r = bench_cache_lookup(engine->db, set);
+		if (r)
+			return r;
+
+		r = bench_lookup_info(engine->db, set);
+		if (r)
+			return r;
+
+		r = bench_lookup_many(engine->db, set);
+		if (r)
+			return r;
+
+		if (set->family == AF_INET) {
+			r = bench_lookup4(engine->db, set);
+			if (r)
+				return r;
+		}
+
+		if (max_threads > 1) {
+			r = bench_threads(engine->db, set);
+			if (r)
+				return r;
+		}
+	}
+
+	return 0;
+}
+
+/*
+	Looks up random AS numbers
+*/
+static int bench_as(struct loc_database* db) {
+	struct loc_as* as = NULL;
+	const char* name = NULL;
+	size_t found = 0;
+
+	uint32_t* numbers = calloc(count, sizeof(*numbers));
+	if (!numbers)
+		return 1;
+
+	// Use the same numbers every time
+	srandom(1);
+
+	for (size_t i = 0; i < count; i++)
+		numbers[i] = random() % 400000;
+
+	printf("ASes:\n");
+
+	double t = now();
+
+	for (size_t i = 0; i < count; i++) {
+		if (loc_database_get_as(db, &as, numbers[i]) == 0) {
+			loc_as_unref(as);
+			found++;
+		}
+	}
+
+	t = now() - t;
+
+	printf("    %-25s %10.1f ns/lookup (%zu/%zu found)\n",
+		"loc_database_get_as", t / count, found, count);
+
+	found = 0;
+	t = now();
+
+	for (size_t i = 0; i < count; i++) {
+		if (loc_database_get_as_name(db, numbers[i], &name) == 0)
+			found++;
+	}
+
+	t = now() - t;
+
+	printf("    %-25s %10.1f ns/lookup (%zu/%zu found)\n",
+		"loc_database_get_as_name", t / count, found, count);
+
+	free(numbers);
+
+	return 0;
+}
+
+static int search_as(struct loc_database* db, const char* string, size_t* found) {
+	struct loc_database_enumerator* enumerator = NULL;
+	struct loc_as* as = NULL;
+	int r;
+
+	*found = 0;
+
+	r = loc_database_enumerator_new(&enumerator, db, LOC_DB_ENUMERATE_ASES, 0);
+	if (r)
+		return r;
+
+	r = loc_database_enumerator_set_string(enumerator, string);
+	if (r)
+		goto ERROR;
+
+	for (;;) {
+		r = loc_database_enumerator_next_as(enumerator, &as);
+		if (r || !as)
+			break;
+
+		loc_as_unref(as);
+		(*found)++;
+	}
+
+ERROR:
+	loc_database_enumerator_unref(enumerator);
+
+	return r;
+}
+
+/*
+	Searches for AS names
+*/
+static int bench_search_as(struct loc_database* db) {
+	const char* strings[] = {
+		"google", "amazon", "deutsche telekom", "ipfire", "net", "de", NULL,
+	};
+	const unsigned int rounds = 100;
+	size_t found = 0;
+	int r;
+
+	printf("AS search:\n");
+
+	// The first search builds the index
+	double t = now();
+
+	r = search_as(db, strings[0], &found);
+	if (r)
+		return r;
+
+	t = now() - t;
+
+	printf("    %-25s %10.1f us/search (%zu found)\n", "first search", t / 1000, found);
+
+	for (const char** string = strings; *string; string++) {
+		t = now();
+
+		for (unsigned int i = 0; i < rounds; i++) {
+			r = search_as(db, *string, &found);
+			if (r)
+				return r;
+		}
+
+		t = now() - t;
+
+		printf("    %-25s %10.1f us/search (%zu found)\n", *string, t / rounds / 1000, found);
+	}
+
+	return 0;
+}
+
+/*
+	Lists all networks of some ASNs
+*/
+static int bench_as_networks(struct loc_ctx* ctx, struct loc_database* db) {
+	const uint32_t asns[] = { 204867, 15169, 3320, 0 };
+	struct loc_database_enumerator* enumerator = NULL;
+	struct loc_network* network = NULL;
+	struct loc_as_list* list = NULL;
+	struct loc_as* as = NULL;
+	size_t found = 0;
+	int r;
+
+	printf("Networks by ASN:\n");
+
+	for (const uint32_t* asn = asns; *asn; asn++) {
+		double t = now();
+
+		r = loc_as_list_new(ctx, &list);
+		if (r)
+			return r;
+
+		r = loc_as_new(ctx, &as, *asn);
+		if (r)
+			goto ERROR;
+
+		r = loc_as_list_append(list, as);
+		loc_as_unref(as);
+		if (r)
+			goto ERROR;
+
+		r = loc_database_enumerator_new(&enumerator, db, LOC_DB_ENUMERATE_NETWORKS, 0);
+		if (r)
+			goto ERROR;
+
+		r = loc_database_enumerator_set_asns(enumerator, list);
+		if (r)
+			goto ERROR;
+
+		for (found = 0;; found++) {
+			r = loc_database_enumerator_next_network(enumerator, &network);
+			if (r || !network)
+				break;
+
+			loc_network_unref(network);
+		}
+
+		loc_database_enumerator_unref(enumerator);
+		enumerator = NULL;
+
+		loc_as_list_unref(list);
+		list = NULL;
+
+		if (r)
+			return r;
+
+		t = now() - t;
+
+		printf("    AS%-23u %10.1f us/search (%zu found)\n", *asn, t / 1000, found);
+	}
+
+	return 0;
+
+ERROR:
+	if (enumerator)
+		loc_database_enumerator_unref(enumerator);
+	if (list)
+		loc_as_list_unref(list);
+
+	return r;
+}
+
+/*
+	Lists all flattened networks of some countries
+*/
+static int bench_country_networks(struct loc_ctx* ctx, struct loc_database* db) {
+	const char* country_codes[] = { "LI", "CH", "DE", "US", NULL };
+	struct loc_database_enumerator* enumerator = NULL;
+	struct loc_country_list* list = NULL;
+	struct loc_network* network = NULL;
+	struct loc_country* country = NULL;
+	size_t found = 0;
+	int r;
+
+	printf("Networks by country:\n");
+
+	for (const char** country_code = country_codes; *country_code; country_code++) {
+		double t = now();
+
+		r = loc_country_list_new(ctx, &list);
+		if (r)
+			return r;
+
+		r = loc_country_new(ctx, &country, *country_code);
+		if (r)
+			goto ERROR;
+
+		r = loc_country_list_append(list, country);
+		loc_country_unref(country);
+		if (r)
+			goto ERROR;
+
+		r = loc_database_enumerator_new(&enumerator, db,
+			LOC_DB_ENUMERATE_NETWORKS, LOC_DB_ENUMERATOR_FLAGS_FLATTEN);
+		if (r)
+			goto ERROR;
+
+		r = loc_database_enumerator_set_countries(enumerator, list);
+		if (r)
+			goto ERROR;
+
+		for (found = 0;; found++) {
+			r = loc_database_enumerator_next_network(enumerator, &network);
+			if (r || !network)
+				break;
+
+			loc_network_unref(network);
+		}
+
+		loc_database_enumerator_unref(enumerator);
+		enumerator = NULL;
+
+		loc_country_list_unref(list);
+		list = NULL;
+
+		if (r)
+			return r;
+
+		t = now() - t;
+
+		printf("    %-25s %10.1f us/search (%zu found)\n", *country_code, t / 1000, found);
+	}
+
+	return 0;
+
+ERROR:
+	if (enumerator)
+		loc_database_enumerator_unref(enumerator);
+	if (list)
+		loc_country_list_unref(list);
+
+	return r;
+}
+
+static int count_network(const struct loc_network_info* network, void* data) {
+	size_t* found = data;
+
+	(*found)++;
+
+	return 0;
+}
+
+/*
+	Dumps all networks one by one, in batches and through a callback
+*/
+static int bench_dump(struct loc_database* db) {
+	struct loc_database_enumerator* enumerator = NULL;
+	struct loc_network_info batch[256];
+	struct loc_network* network = NULL;
+	size_t found = 0;
+	size_t n = 0;
+	double t;
+	int r;
+
+	printf("All networks:\n");
+
+	for (unsigned int i = 0; i < 3; i++) {
+		r = loc_database_enumerator_new(&enumerator, db, LOC_DB_ENUMERATE_NETWORKS, 0);
+		if (r)
+			return r;
+
+		found = 0;
+		t = now();
+
+		switch (i) {
+			case 0:
+				for (;;) {
+					r = loc_database_enumerator_next_network(enumerator, &network);
+					if (r || !network)
+						break;
+
+					loc_network_unref(network);
+					found++;
+				}
+				break;
+
+			case 1:
+				do {
+					r = loc_database_enumerator_next_networks(enumerator,
+						batch, sizeof(batch) / sizeof(*batch), &n);
+
+					found += n;
+				} while (!r && n);
+				break;
+
+			case 2:
+				r = loc_database_enumerator_walk(enumerator, count_network, &found);
+				break;
+		}
+
+		t = now() - t;
+
+		loc_database_enumerator_unref(enumerator);
+
+		if (r)
+			return r;
+
+		printf("    %-38s %10.1f ms (%zu found)\n",
+			(i == 0) ? "loc_database_enumerator_next_network" :
+			(i == 1) ? "loc_database_enumerator_next_networks" :
+			"loc_database_enumerator_walk", t / 1000000, found);
+	}
+
+	return 0;
+}
+
+/*
+	Looks up random country codes
+*/
+static int bench_countries(struct loc_database* db) {
+	struct loc_country* country = NULL;
+	char (*codes)[3] = NULL;
+	size_t found = 0;
+	int r = 0;
+
+	codes = calloc(count, sizeof(*codes));
+	if (!codes)
+		return 1;
+
+	// Use the same codes every time
+	srandom(1);
+
+	for (size_t i = 0; i < count; i++) {
+		// Codes starting with X are reserved
+		codes[i][0] = 'A' + random() % 23;
+		codes[i][1] = 'A' + random() % 26;
+	}
+
+	printf("Countries:\n");
+
+	double t = now();
+
+	for (size_t i = 0; i < count; i++) {
+		r = loc_database_get_country(db, &country, codes[i]);
+		if (r) {
+			fprintf(stderr, "Could not look up country %s: %m\n", codes[i]);
+			goto ERROR;
+		}
+
+		if (country) {
+			loc_country_unref(country);
+			found++;
+		}
+	}
+
+	t = now() - t;
+
+	printf("    %-25s %10.1f ns/lookup (%zu/%zu found)\n",
+		"loc_database_get_country", t / count, found, count);
+
+ERROR:
+	free(codes);
+
+	return r;
+}
+
+int main(int argc, char** argv) {
+	struct set sets[4];
+	unsigned int num_sets = 0;
+	const char* trace = NULL;
+	int c;
+	int r;
+
+	while ((c = getopt(argc, argv, "d:j:n:t:")) != -1) {
+		switch (c) {
+			case 'd':
+				path = optarg;
+				break;
+
+			case 'j':
+				max_threads = strtoul(optarg, NULL, 10);
+				if (!max_threads) {
+					fprintf(stderr, "Invalid number of threads: %s\n", optarg);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 'n':
+				count = strtoul(optarg, NULL, 10);
+				if (!count) {
+					fprintf(stderr, "Invalid count: %s\n", optarg);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 't':
+				trace = optarg;
+				break;
+
+			default:
+				fprintf(stderr, "Usage: %s [-d DATABASE] [-j THREADS] [-n COUNT] [-t TRACE]\n", argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	struct loc_ctx* ctx;
+	r = loc_new(&ctx);
+	if (r < 0)
+		exit(EXIT_FAILURE);
+
+	// Open the database
+	FILE* f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "Could not open %s: %m\n", path);
+		exit(EXIT_FAILURE);
+	}
+
+	// Open a separate handle for each engine
+	for (struct engine* engine = engines; engine->name; engine++) {
+		r = loc_database_new(ctx, &engine->db, f);
+		if (r) {
+			fprintf(stderr, "Could not load the database: %m\n");
+			exit(EXIT_FAILURE);
+		}
+
+		if (engine->validate) {
+			double t = now();
+
+			r = loc_database_validate(engine->db);
+			if (r) {
+				fprintf(stderr, "Could not validate the database: %m\n");
+				exit(EXIT_FAILURE);
+			}
+
+			printf("Validated the database in %.1f ms\n", (now() - t) / 1e6);
+		}
+
+		if (!engine->flags)
+			continue;
+
+		double t = now();
+
+		r = loc_database_build_index(engine->db, engine->flags);
+		if (r) {
+			fprintf(stderr, "Could not build the %s: %m\n", engine->name);
+			exit(EXIT_FAILURE);
+		}
+
+		printf("Built %s in %.1f ms\n", engine->name, (now() - t) / 1e6);
+	}
+
+	// Generate the address sets
+	r = random_set(&sets[num_sets++], "Random IPv4", AF_INET);
+	if (r)
+		exit(EXIT_FAILURE);
+
+	r = random_set(&sets[num_sets++], "Random IPv6", AF_INET6);
+	if (r)
+		exit(EXIT_FAILURE);
+
+	r = zipf_set(&sets[num_sets++], "Zipf IPv4");
+	if (r)
+		exit(EXIT_FAILURE);
+
+	if (trace) {
+		r = trace_set(&sets[num_sets++], trace);
+		if (r)
+			exit(EXIT_FAILURE);
+	}
+
+	for (unsigned int i = 0; i < num_sets; i++) {
+		r = bench(&sets[i]);
+		if (r)
+			exit(EXIT_FAILURE);
+
+		free(sets[i].addresses);
+	}
+
+	r = bench_as(engines[0].db);
+	if (r)
+		exit(EXIT_FAILURE);
+
+	r = bench_search_as(engines[0].db);
+	if (r)
+		exit(EXIT_FAILURE);
+
+	r = bench_as_networks(ctx, engines[0].db);
+	if (r)
+		exit(EXIT_FAILURE);
+
+	r = bench_country_networks(ctx, engines[0].db);
+	if (r)
+		exit(EXIT_FAILURE);
+
+	r = bench_dump(engines[0].db);
+	if (r)
+		exit(EXIT_FAILURE);
+
+	r = bench_countries(engines[0].db);
+	if (r)
+		exit(EXIT_FAILURE);
+
+	for (struct engine* engine = engines; engine->name; engine++)
+		loc_database_unref(engine->db);
+
+	loc_unref(ctx);
+	fclose(f);
+
+	return EXIT_SUCCESS;
+}
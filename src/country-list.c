@@ -15,7 +15,10 @@
 */
 
 #include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <libloc/compat.h>
 #include <libloc/country.h>
@@ -24,14 +27,19 @@
 
 struct loc_country_list {
 	struct loc_ctx* ctx;
-	int refcount;
+	atomic_int refcount;
 
 	struct loc_country** elements;
 	size_t elements_size;
 
 	size_t size;
+
+	// One bit for each country code from AA to ZZ that is in the list
+	uint64_t codes[(26 * 26 + 63) / 64];
 };
 
+#define LOC_COUNTRY_LIST_INDEX(cc)	(((cc)[0] - 'A') * 26 + ((cc)[1] - 'A'))
+
 static int loc_country_list_grow(struct loc_country_list* list) {
 	size_t size = list->elements_size * 2;
 	if (size < 1024)
@@ -109,6 +117,8 @@ LOC_EXPORT void loc_country_list_clear(struct loc_country_list* list) {
 	list->elements_size = 0;
 
 	list->size = 0;
+
+	memset(list->codes, 0, sizeof(list->codes));
 }
 
 LOC_EXPORT struct loc_country* loc_country_list_get(struct loc_country_list* list, size_t index) {
@@ -135,36 +145,27 @@ LOC_EXPORT int loc_country_list_append(
 
 	list->elements[list->size++] = loc_country_ref(country);
 
+	// All country codes are valid
+	const unsigned int index = LOC_COUNTRY_LIST_INDEX(loc_country_get_code(country));
+	list->codes[index / 64] |= (uint64_t)1 << (index % 64);
+
 	return 0;
 }
 
 LOC_EXPORT int loc_country_list_contains(
 		struct loc_country_list* list, struct loc_country* country) {
-	for (unsigned int i = 0; i < list->size; i++) {
-		if (loc_country_cmp(country, list->elements[i]) == 0)
-			return 1;
-	}
-
-	return 0;
+	return loc_country_list_contains_code(list, loc_country_get_code(country));
 }
 
 LOC_EXPORT int loc_country_list_contains_code(
 		struct loc_country_list* list, const char* code) {
-	struct loc_country* country;
-
-	int r = loc_country_new(list->ctx, &country, code);
-	if (r) {
-		// Ignore invalid country codes which would never match
-		if (errno == EINVAL)
-			return 0;
-
-		return r;
-	}
+	// Ignore invalid country codes which would never match
+	if (!loc_country_code_is_valid(code))
+		return 0;
 
-	r = loc_country_list_contains(list, country);
-	loc_country_unref(country);
+	const unsigned int index = LOC_COUNTRY_LIST_INDEX(code);
 
-	return r;
+	return (list->codes[index / 64] & ((uint64_t)1 << (index % 64))) != 0;
 }
 
 static int __loc_country_cmp(const void* country1, const void* country2) {
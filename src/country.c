@@ -15,6 +15,7 @@
 */
 
 #include <errno.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -37,7 +38,7 @@ static const struct loc_special_country {
 
 struct loc_country {
 	struct loc_ctx* ctx;
-	int refcount;
+	atomic_int refcount;
 
 	// Store the country code in a 3 byte buffer. Two bytes for the code, and NULL so
 	// that we can use strcmp() and return a pointer.
@@ -45,6 +46,9 @@ struct loc_country {
 	char continent_code[3];
 
 	char* name;
+
+	// Objects that are shared by a database cannot be changed
+	int readonly;
 };
 
 LOC_EXPORT int loc_country_new(struct loc_ctx* ctx, struct loc_country** country, const char* country_code) {
@@ -106,6 +110,11 @@ LOC_EXPORT const char* loc_country_get_continent_code(struct loc_country* countr
 }
 
 LOC_EXPORT int loc_country_set_continent_code(struct loc_country* country, const char* continent_code) {
+	if (country->readonly) {
+		errno = EPERM;
+		return 1;
+	}
+
 	// Check for valid input
 	if (!continent_code || strlen(continent_code) != 2) {
 		errno = EINVAL;
@@ -123,6 +132,11 @@ LOC_EXPORT const char* loc_country_get_name(struct loc_country* country) {
 }
 
 LOC_EXPORT int loc_country_set_name(struct loc_country* country, const char* name) {
+	if (country->readonly) {
+		errno = EPERM;
+		return 1;
+	}
+
 	if (country->name)
 		free(country->name);
 
@@ -141,6 +155,10 @@ LOC_EXPORT int loc_country_cmp(struct loc_country* country1, struct loc_country*
 	return strncmp(country1->code, country2->code, 2);
 }
 
+void loc_country_set_readonly(struct loc_country* country) {
+	country->readonly = 1;
+}
+
 int loc_country_new_from_database_v1(struct loc_ctx* ctx, struct loc_stringpool* pool,
 		struct loc_country** country, const struct loc_database_country_v1* dbobj) {
 	char buffer[3] = "XX";
@@ -18,6 +18,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include <netinet/in.h>
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -56,6 +57,90 @@ struct loc_database_objects {
 	size_t count;
 };
 
+/*
+	An entry in a table of the stride index which stands for the next
+	eight bits of an address
+*/
+struct loc_database_stride_entry {
+	// The node eight levels further down (zero if the tree ends before) or
+	// the table that continues from there if LOC_DATABASE_STRIDE_TABLE is set
+	uint32_t next;
+
+	// The prefix of the most specific network on the way in the upper eight bits
+	// and its index in the lower bits (LOC_DATABASE_STRIDE_NO_NETWORK if none)
+	uint32_t network;
+};
+
+#define LOC_DATABASE_STRIDE_TABLE		(1u << 31)
+#define LOC_DATABASE_STRIDE_NO_NETWORK	0xffffffff
+
+#define LOC_DATABASE_STRIDE				8
+#define LOC_DATABASE_STRIDE_ENTRIES		(1 << LOC_DATABASE_STRIDE)
+
+// Limit the stride index to 64 MiB
+#define LOC_DATABASE_STRIDE_MAX_TABLES \
+	((64 << 20) / (LOC_DATABASE_STRIDE_ENTRIES * sizeof(struct loc_database_stride_entry)))
+
+/*
+	The DIR-24-8 tables for IPv4 hold one entry for each /24 and for each
+	address in any chunk. An entry either points to a chunk or holds the
+	prefix of the most specific network (relative to IPv4) in the upper eight
+	bits and its index plus one in the lower bits (zero if there is none).
+*/
+#define LOC_DATABASE_DIR24_ENTRIES		(1 << 24)
+#define LOC_DATABASE_DIR24_CHUNK		(1u << 31)
+#define LOC_DATABASE_DIR24_CHUNK_ENTRIES	(1 << 8)
+
+/*
+	A node of the network tree and a network in host byte order
+*/
+struct loc_database_node {
+	uint32_t children[2];
+
+	// The network (LOC_DATABASE_NO_NETWORK if this is not a leaf)
+	uint32_t network;
+};
+
+#define LOC_DATABASE_NO_NETWORK			0xffffffff
+
+struct loc_database_network {
+	uint32_t asn;
+	uint16_t flags;
+	char country_code[2];
+};
+
+/*
+	Maps every country code from AA to ZZ to the position of the country plus one
+	(zero if the database does not have the country)
+*/
+#define LOC_DATABASE_COUNTRY_INDEX_SIZE	(26 * 26)
+
+#define LOC_DATABASE_COUNTRY_INDEX(cc)	(((cc)[0] - 'A') * 26 + ((cc)[1] - 'A'))
+
+/*
+	Lists the positions of all ASes (in ascending order) whose lowercase
+	name contains any trigram that hashes into the same bucket
+*/
+#define LOC_DATABASE_AS_NAME_BUCKETS	(1 << 18)
+
+struct loc_database_as_name_index {
+	// Where the list of each bucket starts (and one more where the last one ends)
+	uint32_t offsets[LOC_DATABASE_AS_NAME_BUCKETS + 1];
+
+	uint32_t* ases;
+};
+
+/*
+	A network index section (see struct loc_database_network_index_v1)
+*/
+struct loc_database_network_index {
+	const struct loc_database_network_index_key_v1* keys;
+	size_t keys_count;
+
+	const struct loc_database_network_index_entry_v1* networks;
+	size_t networks_count;
+};
+
 struct loc_database_signature {
 	const char* data;
 	size_t length;
@@ -63,7 +148,7 @@ struct loc_database_signature {
 
 struct loc_database {
 	struct loc_ctx* ctx;
-	int refcount;
+	atomic_int refcount;
 
 	FILE* f;
 
@@ -86,14 +171,46 @@ struct loc_database {
 	// ASes in the database
 	struct loc_database_objects as_objects;
 
+	// Shared AS objects (by position, created on first use)
+	_Atomic(struct loc_as*)* interned_ases;
+
+	// Index of the AS names (created on the first search)
+	_Atomic(struct loc_database_as_name_index*) as_name_index;
+
 	// Network tree
 	struct loc_database_objects network_node_objects;
 
+	// The node of ::ffff:0:0/96 (zero if there are no IPv4 networks)
+	off_t ipv4_root;
+
+	// Stride index (table 0 starts at the root of the tree)
+	struct loc_database_stride_entry* stride_tables;
+	size_t stride_tables_count;
+
+	// The table of ::ffff:0:0/96 (zero if there is none)
+	uint32_t stride_ipv4_root;
+
+	// DIR-24-8 index for IPv4
+	uint32_t* dir24;
+	uint32_t* dir24_chunks;
+	size_t dir24_chunks_count;
+
 	// Networks
 	struct loc_database_objects network_objects;
 
+	// The networks of each AS and the flattened networks of each country
+	struct loc_database_network_index as_networks;
+	struct loc_database_network_index country_networks;
+
 	// Countries
 	struct loc_database_objects country_objects;
+	uint32_t country_index[LOC_DATABASE_COUNTRY_INDEX_SIZE];
+
+	// Shared country objects (by position, created on first use)
+	_Atomic(struct loc_country*)* interned_countries;
+
+	// Set once loc_database_validate() has checked the network tree
+	int validated;
 };
 
 #define MAX_STACK_DEPTH 256
@@ -102,13 +219,60 @@ struct loc_node_stack {
 	off_t offset;
 	int i; // Is this node 0 or 1?
 	int depth;
+	int inside; // Is this subtree entirely inside the enumerator's range?
+};
+
+/*
+	A run of networks in a network index that the enumerator is walking through
+*/
+struct loc_database_enumerator_run {
+	const struct loc_database_network_index_entry_v1* next;
+	const struct loc_database_network_index_entry_v1* end;
+};
+
+/*
+	A network that the enumerator has found, before any object has been created
+*/
+struct loc_database_enumerator_hit {
+	struct in6_addr address;
+	unsigned int prefix;
+	off_t network;
+};
+
+/*
+	The position of an enumerator as it is stored in a cursor
+*/
+enum loc_database_cursor_state {
+	LOC_DATABASE_CURSOR_START = 0,
+	LOC_DATABASE_CURSOR_AFTER = 1,
+	LOC_DATABASE_CURSOR_END   = 2,
+};
+
+#define LOC_DATABASE_CURSOR_VERSION 1
+
+// Version, state, prefix, address and fingerprint
+#define LOC_DATABASE_CURSOR_SIZE (3 + 16 + 4)
+
+/*
+	A network that encloses the current position of a flattening enumerator
+*/
+struct loc_database_enumerator_flat {
+	struct in6_addr first_address;
+	struct in6_addr last_address;
+
+	// The next address that has not been returned and is not part of a subnet
+	struct in6_addr next_address;
+	int exhausted;
+
+	off_t network;
+	int matches;
 };
 
 struct loc_database_enumerator {
 	struct loc_ctx* ctx;
 	struct loc_database* db;
 	enum loc_database_enumerator_mode mode;
-	int refcount;
+	atomic_int refcount;
 
 	// Search string
 	char* string;
@@ -123,6 +287,11 @@ struct loc_database_enumerator {
 	// Index of the AS we are looking at
 	unsigned int as_index;
 
+	// The ASes that might match the search string (from the AS name index)
+	const uint32_t* as_candidates;
+	size_t as_candidates_count;
+	int as_candidates_ready;
+
 	// Index of the country we are looking at
 	unsigned int country_index;
 
@@ -130,13 +299,67 @@ struct loc_database_enumerator {
 	struct in6_addr network_address;
 	struct loc_node_stack network_stack[MAX_STACK_DEPTH];
 	int network_stack_depth;
-	unsigned int* networks_visited;
 
-	// For subnet search and bogons
-	struct loc_network_list* stack;
-	struct loc_network_list* subnets;
+	// Nodes that have been visited (only for databases that have not been validated)
+	uint64_t* networks_visited;
+
+	// The filter compiled on the first network
+	int filter_ready;
+	uint64_t filter_countries[(LOC_DATABASE_COUNTRY_INDEX_SIZE + 63) / 64];
+	uint32_t* filter_asns;
+	size_t filter_asns_count;
+
+	// Only walk through the subtree of a network
+	int subtree;
+	int supernets;
+
+	// The networks that enclose this subtree
+	struct loc_database_enumerator_hit* enclosing;
+	size_t enclosing_count;
+	size_t enclosing_next;
+
+	// Only return networks that start inside this range
+	int range;
+	struct in6_addr range_first;
+	struct in6_addr range_last;
+
+	// Set if the range only skips everything up to the position of a cursor
+	int range_cursor;
+
+	// Resume behind the position that has been loaded from a cursor
+	enum loc_database_cursor_state cursor;
+	struct in6_addr cursor_address;
+	unsigned int cursor_prefix;
+
+	// The position behind the last network that has been returned
+	enum loc_database_cursor_state position;
+	struct in6_addr position_address;
+	unsigned int position_prefix;
+
+	// Identifies the database and filter the position belongs to
+	uint32_t fingerprint;
+
+	// Runs of networks from a network index (instead of walking the tree)
+	struct loc_database_enumerator_run* runs;
+	size_t runs_count;
+	int runs_ready;
+
+	// Flattening: all networks that enclose the current position in the tree
+	struct loc_database_enumerator_flat flat_stack[LOC_DATABASE_MAX_NESTING];
+	unsigned int flat_depth;
+
+	// The next network from the tree (if it has not been put onto the stack, yet)
+	struct loc_database_enumerator_hit flat_next;
+	int flat_next_ready;
+
+	// The gap that is currently being returned
+	struct in6_addr gap_first;
+	struct in6_addr gap_last;
+	off_t gap_network;
+	int gap;
 
 	// For bogons
+	struct loc_network_list* stack;
 	struct in6_addr gap6_start;
 	struct in6_addr gap4_start;
 };
@@ -184,6 +407,74 @@ static inline char* loc_database_object(struct loc_database* db,
 	return object;
 }
 
+/*
+	Returns a pointer to the n-th object without checking whether it exists.
+	This may only be used for databases that have been validated.
+*/
+static inline char* loc_database_object_unchecked(
+		const struct loc_database_objects* objects, const size_t length, const off_t n) {
+	return objects->data + n * length;
+}
+
+/*
+	Returns the node at position pos
+*/
+static inline const struct loc_database_network_node_v1* loc_database_node(
+		struct loc_database* db, off_t pos) {
+	return (const struct loc_database_network_node_v1*)loc_database_object(db,
+		&db->network_node_objects, sizeof(struct loc_database_network_node_v1), pos);
+}
+
+static inline const struct loc_database_network_node_v1* loc_database_node_unchecked(
+		struct loc_database* db, off_t pos) {
+	return (const struct loc_database_network_node_v1*)loc_database_object_unchecked(
+		&db->network_node_objects, sizeof(struct loc_database_network_node_v1), pos);
+}
+
+/*
+	How the network tree is being read
+*/
+enum loc_database_access {
+	// Check everything that is being read from the file
+	LOC_DATABASE_ACCESS_CHECKED,
+
+	// The database has been validated
+	LOC_DATABASE_ACCESS_VALIDATED,
+};
+
+static inline enum loc_database_access loc_database_access(struct loc_database* db) {
+	if (db->validated)
+		return LOC_DATABASE_ACCESS_VALIDATED;
+
+	return LOC_DATABASE_ACCESS_CHECKED;
+}
+
+/*
+	Reads the node at position pos
+*/
+static inline int loc_database_read_node(struct loc_database* db, off_t pos,
+		struct loc_database_node* node, const enum loc_database_access access) {
+	const struct loc_database_network_node_v1* node_v1 = NULL;
+
+	switch (access) {
+		case LOC_DATABASE_ACCESS_VALIDATED:
+			node_v1 = loc_database_node_unchecked(db, pos);
+			break;
+
+		case LOC_DATABASE_ACCESS_CHECKED:
+			node_v1 = loc_database_node(db, pos);
+			if (!node_v1)
+				return 1;
+			break;
+	}
+
+	node->children[0] = be32toh(node_v1->zero);
+	node->children[1] = be32toh(node_v1->one);
+	node->network     = be32toh(node_v1->network);
+
+	return 0;
+}
+
 static int loc_database_version_supported(struct loc_database* db, uint8_t version) {
 	switch (version) {
 		// Supported versions
@@ -283,6 +574,84 @@ static int loc_database_map_objects(struct loc_database* db, struct loc_database
 	return 0;
 }
 
+static int loc_database_map_network_index(struct loc_database* db,
+		struct loc_database_network_index* index, const off_t offset, const size_t length) {
+	const struct loc_database_network_index_v1* header = NULL;
+
+	// The section is optional
+	if (!offset)
+		return 0;
+
+	header = (const struct loc_database_network_index_v1*)(db->data + offset);
+
+	// Check if we can read the header
+	if (length < sizeof(*header) || !__loc_database_check_boundaries(db, db->data + offset, length))
+		goto ERROR;
+
+	const size_t keys_count = be32toh(header->keys);
+	const size_t networks_count = be32toh(header->networks);
+
+	// Check if all keys and networks are part of the section
+	if ((length - sizeof(*header)) / sizeof(*index->keys) < keys_count)
+		goto ERROR;
+
+	if ((length - sizeof(*header) - keys_count * sizeof(*index->keys))
+			/ sizeof(*index->networks) < networks_count)
+		goto ERROR;
+
+	index->keys = (const struct loc_database_network_index_key_v1*)(header + 1);
+	index->keys_count = keys_count;
+
+	index->networks = (const struct loc_database_network_index_entry_v1*)(index->keys + keys_count);
+	index->networks_count = networks_count;
+
+	return 0;
+
+ERROR:
+	ERROR(db->ctx, "Network index at %jd is corrupt\n", (intmax_t)offset);
+	errno = EBADMSG;
+	return 1;
+}
+
+/*
+	Finds all networks of key in a network index
+*/
+static int loc_database_network_index_find(const struct loc_database_network_index* index,
+		uint32_t key, const struct loc_database_network_index_entry_v1** first, size_t* count) {
+	const struct loc_database_network_index_key_v1* k = NULL;
+	off_t lo = 0;
+	off_t hi = index->keys_count - 1;
+
+	*first = NULL;
+	*count = 0;
+
+	while (lo <= hi) {
+		off_t i = (lo + hi) / 2;
+
+		k = &index->keys[i];
+
+		uint32_t number = be32toh(k->key);
+
+		if (number < key)
+			lo = i + 1;
+		else if (number > key)
+			hi = i - 1;
+
+		// Check that all networks are part of the section
+		else if ((uint64_t)be32toh(k->first) + be32toh(k->count) > index->networks_count) {
+			errno = EBADMSG;
+			return 1;
+
+		} else {
+			*first = &index->networks[be32toh(k->first)];
+			*count = be32toh(k->count);
+			break;
+		}
+	}
+
+	return 0;
+}
+
 static int loc_database_read_signature(struct loc_database* db,
 		struct loc_database_signature* signature, const char* data, const size_t length) {
 	// Check for a plausible signature length
@@ -381,6 +750,20 @@ static int loc_database_read_header_v1(struct loc_database* db) {
 	if (r)
 		return r;
 
+	// Map the networks of each AS
+	r = loc_database_map_network_index(db, &db->as_networks,
+		be32toh(header->as_networks_offset),
+		be32toh(header->as_networks_length));
+	if (r)
+		return r;
+
+	// Map the networks of each country
+	r = loc_database_map_network_index(db, &db->country_networks,
+		be32toh(header->country_networks_offset),
+		be32toh(header->country_networks_length));
+	if (r)
+		return r;
+
 	return 0;
 }
 
@@ -421,6 +804,91 @@ static int loc_database_clone_handle(struct loc_database* db, FILE* f) {
 	return 0;
 }
 
+/*
+	Finds the node of ::ffff:0:0/96 below which all IPv4 networks are stored,
+	so that IPv4 lookups can start there instead of walking down 96 levels.
+*/
+static void loc_database_find_ipv4_root(struct loc_database* db) {
+	const struct loc_database_network_node_v1* node = NULL;
+	off_t node_index = 0;
+
+	for (unsigned int level = 0; level < 96; level++) {
+		node = loc_database_node(db, node_index);
+		if (!node)
+			return;
+
+		// Bits 80 to 95 are set
+		if (level >= 80)
+			node_index = be32toh(node->one);
+		else
+			node_index = be32toh(node->zero);
+
+		// There are no IPv4 networks
+		if (!node_index)
+			return;
+
+		// Leave any broken trees to the regular lookup
+		if ((size_t)node_index >= db->network_node_objects.count)
+			return;
+	}
+
+	DEBUG(db->ctx, "Found the IPv4 root at node %jd\n", (intmax_t)node_index);
+
+	db->ipv4_root = node_index;
+}
+
+/*
+	Builds the index of all countries so that they can be found without
+	searching and regardless of the order in which they have been written
+*/
+static void loc_database_index_countries(struct loc_database* db) {
+	const struct loc_database_country_v1* country_v1 = NULL;
+
+	if (db->version != LOC_DATABASE_VERSION_1)
+		return;
+
+	for (size_t i = 0; i < db->country_objects.count; i++) {
+		country_v1 = (const struct loc_database_country_v1*)loc_database_object(db,
+			&db->country_objects, sizeof(*country_v1), i);
+		if (!country_v1)
+			return;
+
+		const char* cc = country_v1->code;
+
+		// Skip anything that isn't a country code
+		if (cc[0] < 'A' || cc[0] > 'Z' || cc[1] < 'A' || cc[1] > 'Z') {
+			DEBUG(db->ctx, "Skipping invalid country at position %zu\n", i);
+			continue;
+		}
+
+		// Keep the first country if there are duplicates
+		if (db->country_index[LOC_DATABASE_COUNTRY_INDEX(cc)])
+			continue;
+
+		db->country_index[LOC_DATABASE_COUNTRY_INDEX(cc)] = i + 1;
+	}
+}
+
+/*
+	Allocates space to share one object for each AS and country
+*/
+static int loc_database_init_interned(struct loc_database* db) {
+	if (db->as_objects.count) {
+		db->interned_ases = calloc(db->as_objects.count, sizeof(*db->interned_ases));
+		if (!db->interned_ases)
+			return 1;
+	}
+
+	if (db->country_objects.count) {
+		db->interned_countries = calloc(db->country_objects.count,
+			sizeof(*db->interned_countries));
+		if (!db->interned_countries)
+			return 1;
+	}
+
+	return 0;
+}
+
 static int loc_database_open(struct loc_database* db, FILE* f) {
 	int r;
 
@@ -446,6 +914,16 @@ static int loc_database_open(struct loc_database* db, FILE* f) {
 	if (r)
 		return r;
 
+	// Find where the IPv4 networks start
+	loc_database_find_ipv4_root(db);
+
+	// Index all countries
+	loc_database_index_countries(db);
+
+	r = loc_database_init_interned(db);
+	if (r)
+		return r;
+
 	clock_t end = clock();
 
 	INFO(db->ctx, "Opened database in %.4fms\n",
@@ -459,6 +937,31 @@ static void loc_database_free(struct loc_database* db) {
 
 	DEBUG(db->ctx, "Releasing database %p\n", db);
 
+	// Release all shared objects
+	if (db->interned_ases) {
+		for (size_t i = 0; i < db->as_objects.count; i++) {
+			if (db->interned_ases[i])
+				loc_as_unref(db->interned_ases[i]);
+		}
+
+		free(db->interned_ases);
+	}
+
+	if (db->interned_countries) {
+		for (size_t i = 0; i < db->country_objects.count; i++) {
+			if (db->interned_countries[i])
+				loc_country_unref(db->interned_countries[i]);
+		}
+
+		free(db->interned_countries);
+	}
+
+	// Free the AS name index
+	if (db->as_name_index) {
+		free(db->as_name_index->ases);
+		free(db->as_name_index);
+	}
+
 	// Unmap the entire database
 	if (db->data) {
 		r = munmap(db->data, db->length);
@@ -470,6 +973,16 @@ static void loc_database_free(struct loc_database* db) {
 	if (db->pool)
 		loc_stringpool_unref(db->pool);
 
+	// Free the stride index
+	if (db->stride_tables)
+		free(db->stride_tables);
+
+	// Free the DIR-24-8 index
+	if (db->dir24)
+		free(db->dir24);
+	if (db->dir24_chunks)
+		free(db->dir24_chunks);
+
 	// Close database file
 	if (db->f)
 		fclose(db->f);
@@ -732,6 +1245,13 @@ static int loc_database_fetch_as(struct loc_database* db, struct loc_as** as, of
 		return 1;
 	}
 
+	// Return the shared object if it exists
+	*as = atomic_load(&db->interned_ases[pos]);
+	if (*as) {
+		loc_as_ref(*as);
+		return 0;
+	}
+
 	DEBUG(db->ctx, "Fetching AS at position %jd\n", (intmax_t)pos);
 
 	switch (db->version) {
@@ -750,247 +1270,336 @@ static int loc_database_fetch_as(struct loc_database* db, struct loc_as** as, of
 			return 1;
 	}
 
-	if (r == 0)
-		DEBUG(db->ctx, "Got AS%u\n", loc_as_get_number(*as));
+	if (r)
+		return r;
 
-	return r;
+	DEBUG(db->ctx, "Got AS%u\n", loc_as_get_number(*as));
+
+	// Share the object unless another thread has been faster
+	struct loc_as* other = NULL;
+
+	loc_as_set_readonly(*as);
+
+	if (atomic_compare_exchange_strong(&db->interned_ases[pos], &other, *as)) {
+		// Keep a reference for the database
+		loc_as_ref(*as);
+	} else {
+		loc_as_unref(*as);
+		*as = loc_as_ref(other);
+	}
+
+	return 0;
 }
 
-// Performs a binary search to find the AS in the list
-LOC_EXPORT int loc_database_get_as(struct loc_database* db, struct loc_as** as, uint32_t number) {
+/*
+	Performs a binary search over the AS numbers in the database without
+	creating any objects and returns the position of the AS
+*/
+static int loc_database_find_as(struct loc_database* db, uint32_t number, off_t* pos) {
+	const struct loc_database_as_v1* as_v1 = NULL;
 	off_t lo = 0;
 	off_t hi = db->as_objects.count - 1;
 
-#ifdef ENABLE_DEBUG
-	// Save start time
-	clock_t start = clock();
-#endif
+	switch (db->version) {
+		case LOC_DATABASE_VERSION_1:
+			break;
+
+		default:
+			errno = ENOTSUP;
+			return 1;
+	}
+
+	// Check that all ASes can be read so that we don't need to check on every probe
+	if (!__loc_database_check_boundaries(db, db->as_objects.data, db->as_objects.length))
+		return 1;
+
+	const struct loc_database_as_v1* ases = (const struct loc_database_as_v1*)db->as_objects.data;
 
 	while (lo <= hi) {
 		off_t i = (lo + hi) / 2;
 
-		// Fetch AS in the middle between lo and hi
-		int r = loc_database_fetch_as(db, as, i);
-		if (r)
-			return r;
+		as_v1 = &ases[i];
 
 		// Check if this is a match
-		uint32_t as_number = loc_as_get_number(*as);
+		uint32_t as_number = be32toh(as_v1->number);
 		if (as_number == number) {
-#ifdef ENABLE_DEBUG
-			clock_t end = clock();
-
-			// Log how fast this has been
-			DEBUG(db->ctx, "Found AS%u in %.4fms\n", as_number,
-				(double)(end - start) / CLOCKS_PER_SEC * 1000);
-#endif
-
+			*pos = i;
 			return 0;
 		}
 
-		// If it wasn't, we release the AS and
-		// adjust our search pointers
-		loc_as_unref(*as);
-
-		if (as_number < number) {
+		// Otherwise adjust our search pointers
+		if (as_number < number)
 			lo = i + 1;
-		} else
+		else
 			hi = i - 1;
 	}
 
 	// Nothing found
-	*as = NULL;
-
 	return 1;
 }
 
-// Returns the network at position pos
-static int loc_database_fetch_network(struct loc_database* db, struct loc_network** network,
-		struct in6_addr* address, unsigned int prefix, off_t pos) {
-	struct loc_database_network_v1* network_v1 = NULL;
+LOC_EXPORT int loc_database_get_as(struct loc_database* db, struct loc_as** as, uint32_t number) {
+	off_t pos = 0;
 	int r;
 
-	if ((size_t)pos >= db->network_objects.count) {
-		DEBUG(db->ctx, "Network ID out of range: %jd/%jd\n",
-			(intmax_t)pos, (intmax_t)db->network_objects.count);
-		errno = ERANGE;
-		return 1;
-	}
-
-	DEBUG(db->ctx, "Fetching network at position %jd\n", (intmax_t)pos);
+#ifdef ENABLE_DEBUG
+	// Save start time
+	clock_t start = clock();
+#endif
 
-	switch (db->version) {
-		case LOC_DATABASE_VERSION_1:
-			// Read the object
-			network_v1 = (struct loc_database_network_v1*)loc_database_object(db,
-				&db->network_objects, sizeof(*network_v1), pos);
-			if (!network_v1)
-				return 1;
+	*as = NULL;
 
-			r = loc_network_new_from_database_v1(db->ctx, network, address, prefix, network_v1);
-			break;
+	r = loc_database_find_as(db, number, &pos);
+	if (r)
+		return r;
 
-		default:
-			errno = ENOTSUP;
-			return 1;
-	}
+	// Only create an object for the match
+	r = loc_database_fetch_as(db, as, pos);
+	if (r)
+		return r;
 
-	if (r == 0)
-		DEBUG(db->ctx, "Got network %s\n", loc_network_str(*network));
+#ifdef ENABLE_DEBUG
+	clock_t end = clock();
 
-	return r;
-}
+	// Log how fast this has been
+	DEBUG(db->ctx, "Found AS%u in %.4fms\n", number,
+		(double)(end - start) / CLOCKS_PER_SEC * 1000);
+#endif
 
-static int __loc_database_node_is_leaf(const struct loc_database_network_node_v1* node) {
-	return (node->network != htobe32(0xffffffff));
+	return 0;
 }
 
-static int __loc_database_lookup_handle_leaf(struct loc_database* db, const struct in6_addr* address,
-		struct loc_network** network, struct in6_addr* network_address, unsigned int prefix,
-		const struct loc_database_network_node_v1* node) {
-	off_t network_index = be32toh(node->network);
+LOC_EXPORT int loc_database_get_as_name(struct loc_database* db, uint32_t number, const char** name) {
+	const struct loc_database_as_v1* as_v1 = NULL;
+	off_t pos = 0;
+	int r;
 
-	DEBUG(db->ctx, "Handling leaf node at %jd\n", (intmax_t)network_index);
+	*name = NULL;
 
-	// Fetch the network
-	int r = loc_database_fetch_network(db, network, network_address, prefix, network_index);
-	if (r) {
-		ERROR(db->ctx, "Could not fetch network %jd from database: %m\n",
-			(intmax_t)network_index);
+	r = loc_database_find_as(db, number, &pos);
+	if (r)
 		return r;
-	}
 
-	// Check if the given IP address is inside the network
-	if (!loc_network_matches_address(*network, address)) {
-		DEBUG(db->ctx, "Searched address is not part of the network\n");
+	as_v1 = (const struct loc_database_as_v1*)loc_database_object_unchecked(
+		&db->as_objects, sizeof(*as_v1), pos);
 
-		loc_network_unref(*network);
-		*network = NULL;
+	// Return the name straight from the string pool
+	*name = loc_stringpool_get(db->pool, be32toh(as_v1->name));
+	if (!*name)
 		return 1;
-	}
 
-	// A network was found and the IP address matches
 	return 0;
 }
 
-// Searches for an exact match along the path
-static int __loc_database_lookup(struct loc_database* db, const struct in6_addr* address,
-		struct loc_network** network, struct in6_addr* network_address,
-		off_t node_index, unsigned int level) {
-	struct loc_database_network_node_v1* node_v1 = NULL;
+/*
+	AS name index
+*/
+
+#define LOC_DATABASE_AS_NAME_BUCKET_BITS	18
+
+// Returns the name of the AS at position pos straight from the string pool
+static const char* loc_database_as_name_at(struct loc_database* db, off_t pos) {
+	const struct loc_database_as_v1* as_v1 = NULL;
+
+	as_v1 = (const struct loc_database_as_v1*)loc_database_object(db,
+		&db->as_objects, sizeof(*as_v1), pos);
+	if (!as_v1)
+		return NULL;
+
+	return loc_stringpool_get(db->pool, be32toh(as_v1->name));
+}
+
+// Returns the bucket of the trigram that starts at s
+static uint32_t loc_database_as_name_bucket(const char* s) {
+	const uint32_t trigram =
+		  ((uint32_t)tolower((unsigned char)s[0]) << 16)
+		| ((uint32_t)tolower((unsigned char)s[1]) <<  8)
+		| ((uint32_t)tolower((unsigned char)s[2]));
 
-	int r;
+	return (trigram * 2654435761u) >> (32 - LOC_DATABASE_AS_NAME_BUCKET_BITS);
+}
 
-	// Fetch the next node
-	node_v1 = (struct loc_database_network_node_v1*)loc_database_object(db,
-		&db->network_node_objects, sizeof(*node_v1), node_index);
-	if (!node_v1)
+/*
+	Checks whether the name of the AS at position pos contains string
+	(ignoring case) without creating an object
+*/
+static int loc_database_as_name_matches(struct loc_database* db, off_t pos, const char* string) {
+	// Match all ASes when no search string is set
+	if (!string)
 		return 1;
 
-	// Follow the path
-	int bit = loc_address_get_bit(address, level);
-	loc_address_set_bit(network_address, level, bit);
+	const char* name = loc_database_as_name_at(db, pos);
+	if (!name)
+		return 0;
 
-	if (bit == 0)
-		node_index = be32toh(node_v1->zero);
-	else
-		node_index = be32toh(node_v1->one);
+	return strcasestr(name, string) != NULL;
+}
 
-	// If the node index is zero, the tree ends here
-	// and we cannot descend any further
-	if (node_index > 0) {
-		// Check boundaries
-		if ((size_t)node_index >= db->network_node_objects.count) {
-			errno = ERANGE;
-			return 1;
-		}
+static int loc_database_build_as_name_index(struct loc_database* db) {
+	struct loc_database_as_name_index* index = NULL;
+	uint32_t* last = NULL;
+	uint32_t* next = NULL;
+	const char* name = NULL;
+	int r = 1;
 
-		// Move on to the next node
-		r = __loc_database_lookup(db, address, network, network_address, node_index, level + 1);
+	// Nothing to do if the index exists
+	if (atomic_load(&db->as_name_index))
+		return 0;
 
-		// End here if a result was found
-		if (r == 0)
-			return r;
+	clock_t start = clock();
 
-		// Raise any errors
-		else if (r < 0)
-			return r;
+	index = calloc(1, sizeof(*index));
+	if (!index)
+		goto ERROR;
 
-		DEBUG(db->ctx, "No match found below level %u\n", level);
-	} else {
-		DEBUG(db->ctx, "Tree ended at level %u\n", level);
-	}
+	// The last AS that has been counted for each bucket
+	last = malloc(sizeof(*last) * LOC_DATABASE_AS_NAME_BUCKETS);
+	if (!last)
+		goto ERROR;
 
-	// If this node has a leaf, we will check if it matches
-	if (__loc_database_node_is_leaf(node_v1)) {
-		r = __loc_database_lookup_handle_leaf(db, address, network, network_address, level, node_v1);
-		if (r < 0)
-			return r;
+	memset(last, 0xff, sizeof(*last) * LOC_DATABASE_AS_NAME_BUCKETS);
+
+	// Count the ASes in each bucket (every AS only once)
+	for (size_t pos = 0; pos < db->as_objects.count; pos++) {
+		name = loc_database_as_name_at(db, pos);
+		if (!name)
+			continue;
+
+		for (const char* p = name; p[0] && p[1] && p[2]; p++) {
+			const uint32_t bucket = loc_database_as_name_bucket(p);
+
+			if (last[bucket] == pos)
+				continue;
+
+			last[bucket] = pos;
+			index->offsets[bucket + 1]++;
+		}
 	}
 
-	// Return no error - even if nothing was found
-	return 0;
-}
+	// Turn the counts into offsets
+	for (unsigned int i = 0; i < LOC_DATABASE_AS_NAME_BUCKETS; i++)
+		index->offsets[i + 1] += index->offsets[i];
 
-LOC_EXPORT int loc_database_lookup(struct loc_database* db,
-		const struct in6_addr* address, struct loc_network** network) {
-	struct in6_addr network_address;
-	memset(&network_address, 0, sizeof(network_address));
+	index->ases = malloc(sizeof(*index->ases) * (index->offsets[LOC_DATABASE_AS_NAME_BUCKETS] + 1));
+	if (!index->ases)
+		goto ERROR;
 
-	*network = NULL;
+	// Where to store the next AS of each bucket
+	next = malloc(sizeof(*next) * LOC_DATABASE_AS_NAME_BUCKETS);
+	if (!next)
+		goto ERROR;
 
-#ifdef ENABLE_DEBUG
-	// Save start time
-	clock_t start = clock();
-#endif
+	memcpy(next, index->offsets, sizeof(*next) * LOC_DATABASE_AS_NAME_BUCKETS);
+	memset(last, 0xff, sizeof(*last) * LOC_DATABASE_AS_NAME_BUCKETS);
 
-	int r = __loc_database_lookup(db, address, network, &network_address, 0, 0);
+	// Fill all buckets in the order of the ASes
+	for (size_t pos = 0; pos < db->as_objects.count; pos++) {
+		name = loc_database_as_name_at(db, pos);
+		if (!name)
+			continue;
+
+		for (const char* p = name; p[0] && p[1] && p[2]; p++) {
+			const uint32_t bucket = loc_database_as_name_bucket(p);
+
+			if (last[bucket] == pos)
+				continue;
+
+			last[bucket] = pos;
+			index->ases[next[bucket]++] = pos;
+		}
+	}
 
-#ifdef ENABLE_DEBUG
 	clock_t end = clock();
 
-	// Log how fast this has been
-	DEBUG(db->ctx, "Executed network search in %.4fms\n",
+	INFO(db->ctx, "Built AS name index with %u entries in %.4fms\n",
+		index->offsets[LOC_DATABASE_AS_NAME_BUCKETS],
 		(double)(end - start) / CLOCKS_PER_SEC * 1000);
-#endif
+
+	// Share the index unless another thread has been faster
+	struct loc_database_as_name_index* other = NULL;
+
+	if (atomic_compare_exchange_strong(&db->as_name_index, &other, index))
+		index = NULL;
+
+	r = 0;
+
+ERROR:
+	if (index) {
+		if (index->ases)
+			free(index->ases);
+		free(index);
+	}
+	if (last)
+		free(last);
+	if (next)
+		free(next);
 
 	return r;
 }
 
-LOC_EXPORT int loc_database_lookup_from_string(struct loc_database* db,
-		const char* string, struct loc_network** network) {
-	struct in6_addr address;
+/*
+	Reads the properties of the network at position pos without creating an object
+*/
+static int loc_database_read_network(struct loc_database* db,
+		off_t pos, struct loc_database_network* network) {
+	const struct loc_database_network_v1* network_v1 = NULL;
 
-	int r = loc_address_parse(&address, NULL, string);
-	if (r)
-		return r;
+	if (!db->validated && (size_t)pos >= db->network_objects.count) {
+		errno = ERANGE;
+		return 1;
+	}
 
-	return loc_database_lookup(db, &address, network);
+	switch (db->version) {
+		case LOC_DATABASE_VERSION_1:
+			if (db->validated)
+				network_v1 = (const struct loc_database_network_v1*)loc_database_object_unchecked(
+					&db->network_objects, sizeof(*network_v1), pos);
+			else
+				network_v1 = (const struct loc_database_network_v1*)loc_database_object(db,
+					&db->network_objects, sizeof(*network_v1), pos);
+			if (!network_v1)
+				return 1;
+
+			network->asn   = be32toh(network_v1->asn);
+			network->flags = be16toh(network_v1->flags);
+			network->country_code[0] = network_v1->country_code[0];
+			network->country_code[1] = network_v1->country_code[1];
+			return 0;
+
+		default:
+			errno = ENOTSUP;
+			return 1;
+	}
 }
 
-// Returns the country at position pos
-static int loc_database_fetch_country(struct loc_database* db,
-		struct loc_country** country, off_t pos) {
-	struct loc_database_country_v1* country_v1 = NULL;
+// Returns the network at position pos
+static int loc_database_fetch_network(struct loc_database* db, struct loc_network** network,
+		struct in6_addr* address, unsigned int prefix, off_t pos) {
+	struct loc_database_network_v1* network_v1 = NULL;
 	int r;
 
-	// Check if the country is within range
-	if ((size_t)pos >= db->country_objects.count) {
+	if (!db->validated && (size_t)pos >= db->network_objects.count) {
+		DEBUG(db->ctx, "Network ID out of range: %jd/%jd\n",
+			(intmax_t)pos, (intmax_t)db->network_objects.count);
 		errno = ERANGE;
 		return 1;
 	}
 
-	DEBUG(db->ctx, "Fetching country at position %jd\n", (intmax_t)pos);
+	DEBUG(db->ctx, "Fetching network at position %jd\n", (intmax_t)pos);
 
 	switch (db->version) {
 		case LOC_DATABASE_VERSION_1:
 			// Read the object
-			country_v1 = (struct loc_database_country_v1*)loc_database_object(db,
-				&db->country_objects, sizeof(*country_v1), pos);
-			if (!country_v1)
+			if (db->validated)
+				network_v1 = (struct loc_database_network_v1*)loc_database_object_unchecked(
+					&db->network_objects, sizeof(*network_v1), pos);
+			else
+				network_v1 = (struct loc_database_network_v1*)loc_database_object(db,
+					&db->network_objects, sizeof(*network_v1), pos);
+			if (!network_v1)
 				return 1;
 
-			r = loc_country_new_from_database_v1(db->ctx, db->pool, country, country_v1);
+			r = loc_network_new_from_database_v1(db->ctx, network, address, prefix, network_v1);
 			break;
 
 		default:
@@ -998,228 +1607,1872 @@ static int loc_database_fetch_country(struct loc_database* db,
 			return 1;
 	}
 
+#ifdef ENABLE_DEBUG
 	if (r == 0)
-		DEBUG(db->ctx, "Got country %s\n", loc_country_get_code(*country));
+		DEBUG(db->ctx, "Got network %s\n", loc_network_str(*network));
+#endif
 
 	return r;
 }
 
-// Performs a binary search to find the country in the list
-LOC_EXPORT int loc_database_get_country(struct loc_database* db,
-		struct loc_country** country, const char* code) {
-	off_t lo = 0;
-	off_t hi = db->country_objects.count - 1;
+// Returns the properties of the network at position pos
+static int loc_database_fetch_network_info(struct loc_database* db, struct loc_network_info* info,
+		const struct in6_addr* address, unsigned int prefix, off_t pos) {
+	struct loc_database_network_v1* network_v1 = NULL;
 
-	// Check if the country code is valid
-	if (!loc_country_code_is_valid(code)) {
-		errno = EINVAL;
+	if (!db->validated && (size_t)pos >= db->network_objects.count) {
+		DEBUG(db->ctx, "Network ID out of range: %jd/%jd\n",
+			(intmax_t)pos, (intmax_t)db->network_objects.count);
+		errno = ERANGE;
 		return 1;
 	}
 
-#ifdef ENABLE_DEBUG
-	// Save start time
-	clock_t start = clock();
-#endif
+	switch (db->version) {
+		case LOC_DATABASE_VERSION_1:
+			// Read the object
+			if (db->validated)
+				network_v1 = (struct loc_database_network_v1*)loc_database_object_unchecked(
+					&db->network_objects, sizeof(*network_v1), pos);
+			else
+				network_v1 = (struct loc_database_network_v1*)loc_database_object(db,
+					&db->network_objects, sizeof(*network_v1), pos);
+			if (!network_v1)
+				return 1;
 
-	while (lo <= hi) {
-		off_t i = (lo + hi) / 2;
+			return loc_network_info_from_database_v1(info, address, prefix, network_v1);
 
-		// Fetch country in the middle between lo and hi
-		int r = loc_database_fetch_country(db, country, i);
-		if (r)
-			return r;
+		default:
+			errno = ENOTSUP;
+			return 1;
+	}
+}
 
-		// Check if this is a match
-		const char* cc = loc_country_get_code(*country);
-		int result = strcmp(code, cc);
+static int __loc_database_node_is_leaf(const struct loc_database_network_node_v1* node) {
+	return (node->network != htobe32(0xffffffff));
+}
 
-		if (result == 0) {
-#ifdef ENABLE_DEBUG
-			clock_t end = clock();
+/*
+	The state of a walk down the tree for a single address
+*/
+struct loc_database_lookup_state {
+	const struct in6_addr* address;
 
-			// Log how fast this has been
-			DEBUG(db->ctx, "Found country %s in %.4fms\n", cc,
-				(double)(end - start) / CLOCKS_PER_SEC * 1000);
-#endif
+	// The next node to visit (-1 once the walk has ended)
+	off_t node_index;
 
-			return 0;
+	// The current level (and once the walk has ended, the number of leading
+	// bits of the address that the result depends on)
+	unsigned int level;
+
+	// IPv4 networks are stored below ::ffff:0:0/96, so anything above cannot match
+	unsigned int min_level;
+
+	// The deepest leaf so far (-1 if none)
+	off_t network_index;
+	unsigned int prefix;
+};
+
+/*
+	Jumps eight levels at a time through the stride index for as long as
+	there are tables and continues the walk from wherever they end
+*/
+static inline void __loc_database_lookup_stride(struct loc_database* db,
+		struct loc_database_lookup_state* state, uint32_t table) {
+	const struct loc_database_stride_entry* entry = NULL;
+
+	for (;;) {
+		entry = &db->stride_tables[table * LOC_DATABASE_STRIDE_ENTRIES
+			+ state->address->s6_addr[state->level / 8]];
+
+		// Remember the most specific network
+		if (entry->network != LOC_DATABASE_STRIDE_NO_NETWORK) {
+			state->network_index = entry->network & 0xffffff;
+			state->prefix = entry->network >> 24;
 		}
 
-		// If it wasn't, we release the country and
-		// adjust our search pointers
-		loc_country_unref(*country);
+		state->level += LOC_DATABASE_STRIDE;
 
-		if (result > 0) {
-			lo = i + 1;
-		} else
-			hi = i - 1;
+		// Continue with the next table
+		if (entry->next & LOC_DATABASE_STRIDE_TABLE) {
+			table = entry->next & ~LOC_DATABASE_STRIDE_TABLE;
+			continue;
+		}
+
+		// Continue with the tree (or end here)
+		if (entry->next)
+			state->node_index = entry->next;
+		else
+			state->node_index = -1;
+		break;
 	}
+}
 
-	// Nothing found
-	*country = NULL;
+/*
+	Looks up an IPv4 address in the DIR-24-8 index and returns how many bits
+	of the address have been used
+*/
+static inline unsigned int __loc_database_lookup_dir24(struct loc_database* db,
+		uint32_t address, off_t* network_index, unsigned int* prefix) {
+	unsigned int bits = 24;
 
-	return 0;
-}
+	uint32_t entry = db->dir24[address >> 8];
 
-// Enumerator
+	// Look into the chunk
+	if (entry & LOC_DATABASE_DIR24_CHUNK) {
+		entry = db->dir24_chunks[((entry & ~LOC_DATABASE_DIR24_CHUNK) << 8) | (address & 0xff)];
+		bits = 32;
+	}
 
-static void loc_database_enumerator_free(struct loc_database_enumerator* enumerator) {
-	DEBUG(enumerator->ctx, "Releasing database enumerator %p\n", enumerator);
+	if (entry) {
+		*network_index = (entry & 0xffffff) - 1;
+		*prefix = entry >> 24;
+	} else {
+		*network_index = -1;
+	}
 
-	// Release all references
-	loc_database_unref(enumerator->db);
-	loc_unref(enumerator->ctx);
+	return bits;
+}
 
-	if (enumerator->string)
-		free(enumerator->string);
+static inline void __loc_database_lookup_init(struct loc_database* db,
+		struct loc_database_lookup_state* state, const struct in6_addr* address) {
+	state->address = address;
+	state->node_index = 0;
+	state->level = 0;
+	state->min_level = 0;
+	state->network_index = -1;
+	state->prefix = 0;
 
-	if (enumerator->countries)
-		loc_country_list_unref(enumerator->countries);
+	if (IN6_IS_ADDR_V4MAPPED(address)) {
+		state->min_level = 96;
 
-	if (enumerator->asns)
-		loc_as_list_unref(enumerator->asns);
+		// Use the DIR-24-8 index which resolves everything at once
+		if (db->dir24) {
+			state->level = 96 + __loc_database_lookup_dir24(db, ntohl(address->s6_addr32[3]),
+				&state->network_index, &state->prefix);
 
-	// Free network search
-	if (enumerator->networks_visited)
-		free(enumerator->networks_visited);
+			state->prefix += 96;
+			state->node_index = -1;
 
-	// Free subnet/bogons stack
-	if (enumerator->stack)
-		loc_network_list_unref(enumerator->stack);
+		// Skip straight to the IPv4 networks
+		} else if (db->stride_ipv4_root) {
+			state->level = 96;
 
-	if (enumerator->subnets)
-		loc_network_list_unref(enumerator->subnets);
+			__loc_database_lookup_stride(db, state, db->stride_ipv4_root);
 
-	free(enumerator);
+		} else if (db->ipv4_root) {
+			state->node_index = db->ipv4_root;
+			state->level = 96;
+		}
+
+	// Use the stride index for IPv6
+	} else if (db->stride_tables) {
+		__loc_database_lookup_stride(db, state, 0);
+	}
 }
 
-LOC_EXPORT int loc_database_enumerator_new(struct loc_database_enumerator** enumerator,
-		struct loc_database* db, enum loc_database_enumerator_mode mode, int flags) {
+/*
+	Visits the next node and remembers it if it is a leaf. The leaf is more
+	specific than anything that was found before and therefore the best match
+	so far.
+
+	state->node_index will be -1 once the walk has ended.
+
+	Unless access is LOC_DATABASE_ACCESS_CHECKED, the database is known to be
+	intact and nothing is checked.
+*/
+static inline int __loc_database_lookup_step(struct loc_database* db,
+		struct loc_database_lookup_state* state, const enum loc_database_access access) {
+	struct loc_database_node node;
+	off_t node_index;
 	int r;
 
-	struct loc_database_enumerator* e = calloc(1, sizeof(*e));
-	if (!e) {
-		return -ENOMEM;
+	r = loc_database_read_node(db, state->node_index, &node, access);
+	if (r)
+		return r;
+
+	// Remember this leaf
+	if (state->level >= state->min_level && node.network != LOC_DATABASE_NO_NETWORK) {
+		state->network_index = node.network;
+		state->prefix = state->level;
 	}
 
-	// Reference context
-	e->ctx = loc_ref(db->ctx);
-	e->db = loc_database_ref(db);
-	e->mode = mode;
+	// The address has no more bits
+	if (state->level == 128) {
+		state->node_index = -1;
+		return 0;
+	}
+
+	// Follow the path
+	node_index = node.children[loc_address_get_bit(state->address, state->level)];
+
+	// If the node index is zero, the tree ends here
+	if (!node_index) {
+		DEBUG(db->ctx, "Tree ended at level %u\n", state->level);
+
+		// This bit has been used to get here, too
+		state->level++;
+
+		state->node_index = -1;
+		return 0;
+	}
+
+	// Check boundaries
+	if (access == LOC_DATABASE_ACCESS_CHECKED
+			&& (size_t)node_index >= db->network_node_objects.count) {
+		ERROR(db->ctx, "Node index out of range at level %u: %jd/%zu\n",
+			state->level, (intmax_t)node_index, db->network_node_objects.count);
+		errno = ERANGE;
+		return 1;
+	}
+
+	state->node_index = node_index;
+	state->level++;
+
+	return 0;
+}
+
+/*
+	Walks down the tree along the bits of address and finds the deepest
+	leaf on the way. That leaf is the most specific network that contains
+	the address.
+*/
+static int __loc_database_lookup(struct loc_database* db,
+		struct loc_database_lookup_state* state, const struct in6_addr* address) {
+	int r;
+
+	__loc_database_lookup_init(db, state, address);
+
+	// Take the fast paths if the tree is known to be intact
+	switch (loc_database_access(db)) {
+		case LOC_DATABASE_ACCESS_VALIDATED:
+			while (state->node_index >= 0)
+				__loc_database_lookup_step(db, state, LOC_DATABASE_ACCESS_VALIDATED);
+			break;
+
+		case LOC_DATABASE_ACCESS_CHECKED:
+			while (state->node_index >= 0) {
+				r = __loc_database_lookup_step(db, state, LOC_DATABASE_ACCESS_CHECKED);
+				if (r)
+					return r;
+			}
+			break;
+	}
+
+	return 0;
+}
+
+/*
+	Copies the properties of the network that a walk has ended up with
+*/
+static int __loc_database_lookup_info(struct loc_database* db,
+		const struct loc_database_lookup_state* state, struct loc_network_info* info) {
+	int r;
+
+	// Reset the result (family will be AF_UNSPEC if nothing was found)
+	memset(info, 0, sizeof(*info));
+
+	// Nothing found
+	if (state->network_index < 0)
+		return 0;
+
+	r = loc_database_fetch_network_info(db, info, state->address,
+		state->prefix, state->network_index);
+	if (r) {
+		ERROR(db->ctx, "Could not fetch network %jd from database: %m\n",
+			(intmax_t)state->network_index);
+		memset(info, 0, sizeof(*info));
+		return r;
+	}
+
+	return 0;
+}
+
+LOC_EXPORT int loc_database_lookup(struct loc_database* db,
+		const struct in6_addr* address, struct loc_network** network) {
+	struct loc_database_lookup_state state;
+	struct in6_addr network_address = *address;
+	int r;
+
+	*network = NULL;
+
+#ifdef ENABLE_DEBUG
+	// Save start time
+	clock_t start = clock();
+#endif
+
+	r = __loc_database_lookup(db, &state, address);
+	if (r)
+		return r;
+
+	// Fetch the network if something was found
+	if (state.network_index >= 0) {
+		r = loc_database_fetch_network(db, network, &network_address,
+			state.prefix, state.network_index);
+		if (r) {
+			ERROR(db->ctx, "Could not fetch network %jd from database: %m\n",
+				(intmax_t)state.network_index);
+			return r;
+		}
+	}
+
+#ifdef ENABLE_DEBUG
+	clock_t end = clock();
+
+	// Log how fast this has been
+	DEBUG(db->ctx, "Executed network search in %.4fms\n",
+		(double)(end - start) / CLOCKS_PER_SEC * 1000);
+#endif
+
+	return 0;
+}
+
+LOC_EXPORT int loc_database_lookup_info(struct loc_database* db,
+		const struct in6_addr* address, struct loc_network_info* info) {
+	struct loc_database_lookup_state state;
+	int r;
+
+	r = __loc_database_lookup(db, &state, address);
+	if (r) {
+		memset(info, 0, sizeof(*info));
+		return r;
+	}
+
+	return __loc_database_lookup_info(db, &state, info);
+}
+
+LOC_EXPORT int loc_database_lookup4(struct loc_database* db,
+		uint32_t address, struct loc_network_info* info) {
+	off_t network_index = -1;
+	unsigned int prefix = 0;
+	int r;
+
+	// Map the address
+	const struct in6_addr network_address = {
+		.s6_addr32 = { 0, 0, htonl(0xffff), htonl(address) },
+	};
+
+	// Everything but the DIR-24-8 index takes the regular walk
+	if (!db->dir24)
+		return loc_database_lookup_info(db, &network_address, info);
+
+	// Reset the result (family will be AF_UNSPEC if nothing was found)
+	memset(info, 0, sizeof(*info));
+
+	__loc_database_lookup_dir24(db, address, &network_index, &prefix);
+
+	// Nothing found
+	if (network_index < 0)
+		return 0;
+
+	r = loc_database_fetch_network_info(db, info, &network_address, prefix + 96, network_index);
+	if (r) {
+		ERROR(db->ctx, "Could not fetch network %jd from database: %m\n",
+			(intmax_t)network_index);
+		memset(info, 0, sizeof(*info));
+		return r;
+	}
+
+	return 0;
+}
+
+/*
+	The number of walks that loc_database_lookup_many() interleaves
+*/
+#define LOOKUP_LANES 8
+
+/*
+	The number of nodes that each walk visits on its own before it is being
+	interleaved with others. The top of the tree is usually cached, so most
+	IPv6 walks end here and interleaving them would only add overhead.
+*/
+#define LOOKUP_SHORT_WALK 16
+
+struct loc_database_lookup_lane {
+	struct loc_database_lookup_state state;
+
+	// The position of the address
+	size_t i;
+};
+
+/*
+	Starts the walk for the address at position i and walks it for as long
+	as it is short. Returns 1 if the walk has to continue in a lane, 0 if the
+	result has been stored, or -1 on error.
+*/
+static inline int __loc_database_lookup_many_start(struct loc_database* db,
+		const struct in6_addr* addresses, struct loc_network_info* results, size_t i,
+		struct loc_database_lookup_state* state, const enum loc_database_access access) {
+	int r;
+
+	__loc_database_lookup_init(db, state, &addresses[i]);
+
+	for (unsigned int step = 0; state->node_index >= 0; step++) {
+		// This walk is long
+		if (step == LOOKUP_SHORT_WALK)
+			return 1;
+
+		r = __loc_database_lookup_step(db, state, access);
+		if (r) {
+			memset(&results[i], 0, sizeof(*results));
+			return -1;
+		}
+	}
+
+	r = __loc_database_lookup_info(db, state, &results[i]);
+	if (r)
+		return -1;
+
+	return 0;
+}
+
+static inline int __loc_database_lookup_many(struct loc_database* db,
+		const struct in6_addr* addresses, size_t count, struct loc_network_info* results,
+		const enum loc_database_access access) {
+	struct loc_database_lookup_lane lanes[LOOKUP_LANES];
+	unsigned int running = 0;
+	size_t next = 0;
+	int r = 0;
+
+	for (;;) {
+		// Give every free lane a long walk
+		for (unsigned int lane = 0; lane < LOOKUP_LANES && next < count; lane++) {
+			if (running & (1u << lane))
+				continue;
+
+			while (next < count) {
+				lanes[lane].i = next;
+
+				r = __loc_database_lookup_many_start(db, addresses, results, next++,
+					&lanes[lane].state, access);
+				if (r < 0)
+					goto ERROR;
+
+				if (r) {
+					running |= (1u << lane);
+					break;
+				}
+			}
+		}
+
+		if (!running)
+			break;
+
+		/*
+			Advance all long walks by one level at a time. While one walk is waiting
+			for its next node to arrive from memory, the others can make progress.
+		*/
+		for (unsigned int lane = 0; lane < LOOKUP_LANES; lane++) {
+			struct loc_database_lookup_state* state = &lanes[lane].state;
+
+			if (!(running & (1u << lane)))
+				continue;
+
+			r = __loc_database_lookup_step(db, state, access);
+			if (r)
+				goto ERROR;
+
+			// Fetch the next node ahead of time
+			if (state->node_index >= 0) {
+				__builtin_prefetch(db->network_node_objects.data +
+					state->node_index * sizeof(struct loc_database_network_node_v1));
+				continue;
+			}
+
+			// Store the result and free the lane
+			running &= ~(1u << lane);
+
+			r = __loc_database_lookup_info(db, state, &results[lanes[lane].i]);
+			if (r)
+				goto ERROR;
+		}
+	}
+
+	return 0;
+
+ERROR:
+	// Reset the results of all addresses that have not been looked up
+	for (unsigned int lane = 0; lane < LOOKUP_LANES; lane++) {
+		if (running & (1u << lane))
+			memset(&results[lanes[lane].i], 0, sizeof(*results));
+	}
+
+	if (next < count)
+		memset(&results[next], 0, (count - next) * sizeof(*results));
+
+	return 1;
+}
+
+LOC_EXPORT int loc_database_lookup_many(struct loc_database* db,
+		const struct in6_addr* addresses, size_t count, struct loc_network_info* results) {
+	switch (loc_database_access(db)) {
+		case LOC_DATABASE_ACCESS_VALIDATED:
+			return __loc_database_lookup_many(db, addresses, count, results,
+				LOC_DATABASE_ACCESS_VALIDATED);
+
+		case LOC_DATABASE_ACCESS_CHECKED:
+			break;
+	}
+
+	return __loc_database_lookup_many(db, addresses, count, results,
+		LOC_DATABASE_ACCESS_CHECKED);
+}
+
+LOC_EXPORT int loc_database_lookup_from_string(struct loc_database* db,
+		const char* string, struct loc_network** network) {
+	struct in6_addr address;
+
+	int r = loc_address_parse(&address, NULL, string);
+	if (r)
+		return r;
+
+	return loc_database_lookup(db, &address, network);
+}
+
+/*
+	Lookup Cache
+*/
+
+struct loc_database_cache_entry {
+	// The address that has been looked up
+	struct in6_addr address;
+
+	// The number of leading bits of the address that the result depends on
+	// (zero if this entry is empty)
+	unsigned int bits;
+
+	// The result (NULL if nothing was found)
+	struct loc_network* network;
+};
+
+struct loc_database_cache {
+	struct loc_ctx* ctx;
+	struct loc_database* db;
+	atomic_int refcount;
+
+	// The entries (a power of two)
+	struct loc_database_cache_entry* entries;
+	size_t size;
+
+	// Bitmasks to find the bucket of an address
+	struct in6_addr bucket4;
+	struct in6_addr bucket6;
+
+	// Statistics
+	uint64_t hits;
+	uint64_t misses;
+};
+
+#define LOC_DATABASE_CACHE_DEFAULT_SIZE 4096
+
+LOC_EXPORT int loc_database_cache_new(struct loc_database_cache** cache,
+		struct loc_database* db, size_t size, unsigned int prefix4, unsigned int prefix6) {
+	struct loc_database_cache* c = NULL;
+
+	// Check the prefixes
+	if (prefix4 > 32 || prefix6 > 128) {
+		errno = EINVAL;
+		return 1;
+	}
+
+	// Use the default size
+	if (!size)
+		size = LOC_DATABASE_CACHE_DEFAULT_SIZE;
+
+	// Round up to the next power of two
+	while (size & (size - 1))
+		size = (size | (size - 1)) + 1;
+
+	c = calloc(1, sizeof(*c));
+	if (!c)
+		return 1;
+
+	// Reference context & database
+	c->ctx = loc_ref(db->ctx);
+	c->db = loc_database_ref(db);
+	c->refcount = 1;
+
+	c->entries = calloc(size, sizeof(*c->entries));
+	if (!c->entries) {
+		loc_database_cache_unref(c);
+		return 1;
+	}
+
+	c->size = size;
+
+	c->bucket4 = loc_prefix_to_bitmask(prefix4 + 96);
+	c->bucket6 = loc_prefix_to_bitmask(prefix6);
+
+	DEBUG(c->ctx, "Lookup cache allocated at %p (%zu entries)\n", c, size);
+
+	*cache = c;
+	return 0;
+}
+
+LOC_EXPORT struct loc_database_cache* loc_database_cache_ref(struct loc_database_cache* cache) {
+	cache->refcount++;
+
+	return cache;
+}
+
+static void loc_database_cache_free(struct loc_database_cache* cache) {
+	DEBUG(cache->ctx, "Releasing lookup cache %p\n", cache);
+
+	if (cache->entries) {
+		for (unsigned int i = 0; i < cache->size; i++) {
+			if (cache->entries[i].network)
+				loc_network_unref(cache->entries[i].network);
+		}
+
+		free(cache->entries);
+	}
+
+	loc_database_unref(cache->db);
+	loc_unref(cache->ctx);
+	free(cache);
+}
+
+LOC_EXPORT struct loc_database_cache* loc_database_cache_unref(struct loc_database_cache* cache) {
+	if (--cache->refcount > 0)
+		return NULL;
+
+	loc_database_cache_free(cache);
+	return NULL;
+}
+
+/*
+	Checks whether two addresses share the same leading bits
+*/
+static inline int loc_database_cache_match(const struct in6_addr* a1,
+		const struct in6_addr* a2, unsigned int bits) {
+	const struct in6_addr bitmask = loc_prefix_to_bitmask(bits);
+
+	for (unsigned int i = 0; i < 4; i++) {
+		if ((a1->s6_addr32[i] ^ a2->s6_addr32[i]) & bitmask.s6_addr32[i])
+			return 0;
+	}
+
+	return 1;
+}
+
+static inline struct loc_database_cache_entry* loc_database_cache_find(
+		struct loc_database_cache* cache, const struct in6_addr* address) {
+	struct in6_addr bucket;
+	uint64_t hash = 0;
+
+	// Truncate the address to its bucket
+	if (IN6_IS_ADDR_V4MAPPED(address))
+		bucket = loc_address_and(address, &cache->bucket4);
+	else
+		bucket = loc_address_and(address, &cache->bucket6);
+
+	// Hash the bucket
+	for (unsigned int i = 0; i < 4; i++)
+		hash = (hash ^ bucket.s6_addr32[i]) * 0x9e3779b97f4a7c15;
+
+	return &cache->entries[(hash >> 32) & (cache->size - 1)];
+}
+
+LOC_EXPORT int loc_database_cache_lookup(struct loc_database_cache* cache,
+		const struct in6_addr* address, struct loc_network** network) {
+	struct loc_database_lookup_state state;
+	struct in6_addr network_address = *address;
+	int r;
+
+	*network = NULL;
+
+	struct loc_database_cache_entry* entry = loc_database_cache_find(cache, address);
+
+	// Return the cached result if it applies to this address
+	if (entry->bits && loc_database_cache_match(&entry->address, address, entry->bits)) {
+		cache->hits++;
+
+		if (entry->network)
+			*network = loc_network_ref(entry->network);
+
+		return 0;
+	}
+
+	cache->misses++;
+
+	r = __loc_database_lookup(cache->db, &state, address);
+	if (r)
+		return r;
+
+	// Fetch the network if something was found
+	if (state.network_index >= 0) {
+		r = loc_database_fetch_network(cache->db, network, &network_address,
+			state.prefix, state.network_index);
+		if (r) {
+			ERROR(cache->ctx, "Could not fetch network %jd from database: %m\n",
+				(intmax_t)state.network_index);
+			return r;
+		}
+	}
+
+	// The network will be shared with everyone who hits this entry
+	if (*network)
+		loc_network_set_readonly(*network);
+
+	// Replace whatever was stored before
+	if (entry->network)
+		loc_network_unref(entry->network);
+
+	entry->address = *address;
+	entry->bits = state.level;
+	entry->network = (*network) ? loc_network_ref(*network) : NULL;
+
+	return 0;
+}
+
+LOC_EXPORT uint64_t loc_database_cache_hits(struct loc_database_cache* cache) {
+	return cache->hits;
+}
+
+LOC_EXPORT uint64_t loc_database_cache_misses(struct loc_database_cache* cache) {
+	return cache->misses;
+}
+
+/*
+	Fills all entries of a stride table by walking eight levels down from
+	the given node for each of them
+*/
+static int loc_database_stride_fill(struct loc_database* db,
+		struct loc_database_stride_entry* table, off_t node_index, unsigned int level) {
+	const struct loc_database_network_node_v1* node = NULL;
+	struct loc_database_stride_entry* entry = NULL;
+	off_t index;
+
+	for (unsigned int bits = 0; bits < LOC_DATABASE_STRIDE_ENTRIES; bits++) {
+		entry = &table[bits];
+		index = node_index;
+
+		entry->network = LOC_DATABASE_STRIDE_NO_NETWORK;
+
+		for (unsigned int i = 0; i <= LOC_DATABASE_STRIDE; i++) {
+			node = loc_database_node(db, index);
+			if (!node)
+				return 1;
+
+			// Remember the most specific network
+			if (__loc_database_node_is_leaf(node))
+				entry->network = ((level + i) << 24) | be32toh(node->network);
+
+			// We have arrived at the next table
+			if (i == LOC_DATABASE_STRIDE) {
+				entry->next = index;
+				break;
+			}
+
+			// Follow the path
+			if (bits & (1 << (LOC_DATABASE_STRIDE - 1 - i)))
+				index = be32toh(node->one);
+			else
+				index = be32toh(node->zero);
+
+			// The tree ends here
+			if (!index)
+				break;
+
+			// Check boundaries
+			if ((size_t)index >= db->network_node_objects.count) {
+				errno = ERANGE;
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int loc_database_build_stride_index(struct loc_database* db) {
+	struct loc_database_stride_entry* tables = NULL;
+	struct loc_database_stride_entry* entry = NULL;
+	off_t* nodes = NULL;
+	unsigned int* levels = NULL;
+	size_t count = 0;
+	int r = 1;
+
+	// Nothing to do if the index already exists
+	if (db->stride_tables)
+		return 0;
+
+	// Nothing to do if there is no tree
+	if (!db->network_node_objects.count)
+		return 0;
+
+	// Check if all indices fit into the entries
+	if (db->network_node_objects.count > LOC_DATABASE_STRIDE_TABLE
+			|| db->network_objects.count > 0xffffff) {
+		errno = ENOTSUP;
+		goto ERROR;
+	}
+
+	clock_t start = clock();
+
+	tables = calloc(LOC_DATABASE_STRIDE_MAX_TABLES * LOC_DATABASE_STRIDE_ENTRIES, sizeof(*tables));
+	if (!tables)
+		goto ERROR;
+
+	// The node and level where each table starts
+	nodes = calloc(LOC_DATABASE_STRIDE_MAX_TABLES, sizeof(*nodes));
+	if (!nodes)
+		goto ERROR;
+
+	levels = calloc(LOC_DATABASE_STRIDE_MAX_TABLES, sizeof(*levels));
+	if (!levels)
+		goto ERROR;
+
+	// The first table starts at the root
+	nodes[count] = 0;
+	levels[count] = 0;
+	count++;
+
+	// IPv4 networks have their own table
+	if (db->ipv4_root) {
+		db->stride_ipv4_root = count;
+
+		nodes[count] = db->ipv4_root;
+		levels[count] = 96;
+		count++;
+	}
+
+	/*
+		Fill the tables level by level and add more tables below them for as long as
+		there is space. That way, the upper levels of the tree are always covered.
+	*/
+	for (size_t t = 0; t < count; t++) {
+		const unsigned int level = levels[t];
+
+		r = loc_database_stride_fill(db, tables + t * LOC_DATABASE_STRIDE_ENTRIES,
+			nodes[t], level);
+		if (r)
+			goto ERROR;
+
+		// Do not add any tables for the last levels
+		if (level + LOC_DATABASE_STRIDE >= 128)
+			continue;
+
+		for (unsigned int bits = 0; bits < LOC_DATABASE_STRIDE_ENTRIES; bits++) {
+			entry = &tables[t * LOC_DATABASE_STRIDE_ENTRIES + bits];
+
+			if (!entry->next)
+				continue;
+
+			// IPv4 networks are handled by their own table
+			if (entry->next == db->ipv4_root)
+				continue;
+
+			// Stop if we are out of space
+			if (count >= LOC_DATABASE_STRIDE_MAX_TABLES)
+				break;
+
+			nodes[count] = entry->next;
+			levels[count] = level + LOC_DATABASE_STRIDE;
+
+			// Link the new table
+			entry->next = LOC_DATABASE_STRIDE_TABLE | count++;
+		}
+	}
+
+	// Give back any unused memory
+	db->stride_tables = realloc(tables, count * LOC_DATABASE_STRIDE_ENTRIES * sizeof(*tables));
+	if (!db->stride_tables)
+		db->stride_tables = tables;
+
+	db->stride_tables_count = count;
+	tables = NULL;
+
+	clock_t end = clock();
+
+	INFO(db->ctx, "Built stride index with %zu table(s) (%zu KiB) in %.4fms\n",
+		count, count * LOC_DATABASE_STRIDE_ENTRIES * sizeof(*tables) / 1024,
+		(double)(end - start) / CLOCKS_PER_SEC * 1000);
+
+	r = 0;
+
+ERROR:
+	if (r) {
+		ERROR(db->ctx, "Could not build stride index: %m\n");
+
+		db->stride_ipv4_root = 0;
+	}
+	if (tables)
+		free(tables);
+	if (nodes)
+		free(nodes);
+	if (levels)
+		free(levels);
+
+	return r;
+}
+
+/*
+	Fills the entries of the DIR-24-8 table (or a chunk) below the given node.
+	position holds the bits of the path so far and best the entry of the most
+	specific network on the way.
+*/
+static int loc_database_dir24_fill(struct loc_database* db, uint32_t* table,
+		unsigned int bits, unsigned int offset, off_t node_index, unsigned int depth,
+		uint32_t position, uint32_t best) {
+	const struct loc_database_network_node_v1* node = NULL;
+	uint32_t* chunks = NULL;
+	off_t child;
+	int r;
+
+	node = loc_database_node(db, node_index);
+	if (!node)
+		return 1;
+
+	// Remember this leaf
+	if (__loc_database_node_is_leaf(node))
+		best = ((offset + depth) << 24) | (be32toh(node->network) + 1);
+
+	// We have arrived at the end of this table
+	if (depth == bits) {
+		// There is nothing more specific
+		if (offset || (!node->zero && !node->one)) {
+			table[position] = best;
+			return 0;
+		}
+
+		const size_t count = db->dir24_chunks_count;
+
+		// Double the space for chunks whenever it is full
+		if (!(count & (count - 1))) {
+			chunks = reallocarray(db->dir24_chunks, count ? count * 2 : 1,
+				sizeof(*chunks) * LOC_DATABASE_DIR24_CHUNK_ENTRIES);
+			if (!chunks)
+				return 1;
+
+			db->dir24_chunks = chunks;
+		}
+
+		db->dir24_chunks_count++;
+
+		// Link the chunk
+		table[position] = LOC_DATABASE_DIR24_CHUNK | count;
+
+		// Fill the chunk (which will not allocate any more chunks)
+		return loc_database_dir24_fill(db,
+			db->dir24_chunks + count * LOC_DATABASE_DIR24_CHUNK_ENTRIES,
+			8, 24, node_index, 0, 0, best);
+	}
+
+	for (unsigned int bit = 0; bit < 2; bit++) {
+		if (bit)
+			child = be32toh(node->one);
+		else
+			child = be32toh(node->zero);
+
+		// Descend into the child
+		if (child) {
+			// Check boundaries
+			if ((size_t)child >= db->network_node_objects.count) {
+				errno = ERANGE;
+				return 1;
+			}
+
+			r = loc_database_dir24_fill(db, table, bits, offset, child, depth + 1,
+				(position << 1) | bit, best);
+			if (r)
+				return r;
+
+		// Otherwise the rest of this part of the table belongs to best
+		} else {
+			const unsigned int shift = bits - depth - 1;
+			const uint32_t first = ((position << 1) | bit) << shift;
+
+			for (uint32_t i = first; i < first + (1u << shift); i++)
+				table[i] = best;
+		}
+	}
+
+	return 0;
+}
+
+static int loc_database_build_dir24_index(struct loc_database* db) {
+	int r = 1;
+
+	// Nothing to do if the index already exists
+	if (db->dir24)
+		return 0;
+
+	// Nothing to do if there are no IPv4 networks
+	if (!db->ipv4_root)
+		return 0;
+
+	// Check if all network indices fit into the entries
+	if (db->network_objects.count >= 0xffffff) {
+		errno = ENOTSUP;
+		goto ERROR;
+	}
+
+	clock_t start = clock();
+
+	db->dir24 = calloc(LOC_DATABASE_DIR24_ENTRIES, sizeof(*db->dir24));
+	if (!db->dir24)
+		goto ERROR;
+
+	r = loc_database_dir24_fill(db, db->dir24, 24, 0, db->ipv4_root, 0, 0, 0);
+	if (r)
+		goto ERROR;
+
+	// Give back any unused memory
+	if (db->dir24_chunks) {
+		uint32_t* chunks = reallocarray(db->dir24_chunks, db->dir24_chunks_count,
+			sizeof(*chunks) * LOC_DATABASE_DIR24_CHUNK_ENTRIES);
+		if (chunks)
+			db->dir24_chunks = chunks;
+	}
+
+	clock_t end = clock();
+
+	INFO(db->ctx, "Built DIR-24-8 index with %zu chunk(s) (%zu KiB) in %.4fms\n",
+		db->dir24_chunks_count, (LOC_DATABASE_DIR24_ENTRIES + db->dir24_chunks_count
+			* LOC_DATABASE_DIR24_CHUNK_ENTRIES) * sizeof(*db->dir24) / 1024,
+		(double)(end - start) / CLOCKS_PER_SEC * 1000);
+
+	return 0;
+
+ERROR:
+	ERROR(db->ctx, "Could not build DIR-24-8 index: %m\n");
+
+	if (db->dir24) {
+		free(db->dir24);
+		db->dir24 = NULL;
+	}
+
+	if (db->dir24_chunks) {
+		free(db->dir24_chunks);
+		db->dir24_chunks = NULL;
+	}
+
+	db->dir24_chunks_count = 0;
+
+	return r;
+}
+
+LOC_EXPORT int loc_database_build_index(struct loc_database* db, int flags) {
+	int r;
+
+	// Build the stride index
+	if (flags & LOC_DB_INDEX_STRIDE) {
+		r = loc_database_build_stride_index(db);
+		if (r)
+			return r;
+	}
+
+	// Build the DIR-24-8 index
+	if (flags & LOC_DB_INDEX_DIR24) {
+		r = loc_database_build_dir24_index(db);
+		if (r)
+			return r;
+	}
+
+	// Index the AS names
+	if (flags & LOC_DB_INDEX_AS_NAMES) {
+		r = loc_database_build_as_name_index(db);
+		if (r)
+			return r;
+	}
+
+	return 0;
+}
+
+/*
+	Validation
+*/
+
+static int loc_database_validate_objects(struct loc_database* db,
+		const struct loc_database_objects* objects, const char* name) {
+	if (!__loc_database_check_boundaries(db, objects->data, objects->length)) {
+		ERROR(db->ctx, "The %s are not part of the database\n", name);
+		errno = EBADMSG;
+		return 1;
+	}
+
+	return 0;
+}
+
+static int loc_database_validate_tree(struct loc_database* db) {
+	const struct loc_database_network_node_v1* node = NULL;
+	struct loc_node_stack stack[MAX_STACK_DEPTH];
+	int depth = 0;
+	int r = 1;
+
+	const size_t count = db->network_node_objects.count;
+
+	// Every lookup starts at the root
+	if (!count) {
+		ERROR(db->ctx, "The network tree is empty\n");
+		errno = EBADMSG;
+		return 1;
+	}
+
+	// Remember which nodes we have seen
+	uint64_t* visited = calloc((count + 63) / 64, sizeof(*visited));
+	if (!visited)
+		return 1;
+
+	// Start at the root
+	stack[depth++] = (struct loc_node_stack){ .offset = 0, .depth = 0 };
+
+	while (depth > 0) {
+		const struct loc_node_stack* top = &stack[--depth];
+
+		const off_t node_index = top->offset;
+		const int level = top->depth;
+
+		// Any node must only be reachable on one path which also rules out any loops
+		if (visited[node_index / 64] & (1ull << (node_index % 64))) {
+			ERROR(db->ctx, "Node %jd can be reached more than once\n", (intmax_t)node_index);
+			errno = EBADMSG;
+			goto ERROR;
+		}
+
+		visited[node_index / 64] |= (1ull << (node_index % 64));
+
+		node = loc_database_node_unchecked(db, node_index);
+
+		// Check the network
+		if (__loc_database_node_is_leaf(node)) {
+			if (be32toh(node->network) >= db->network_objects.count) {
+				ERROR(db->ctx, "Node %jd points to network %u which does not exist\n",
+					(intmax_t)node_index, be32toh(node->network));
+				errno = EBADMSG;
+				goto ERROR;
+			}
+		}
+
+		const uint32_t children[] = { be32toh(node->zero), be32toh(node->one) };
+
+		for (unsigned int i = 0; i < 2; i++) {
+			// The tree ends here
+			if (!children[i])
+				continue;
+
+			// Addresses have no more than 128 bits
+			if (level >= 128) {
+				ERROR(db->ctx, "Node %jd is deeper than 128 levels\n", (intmax_t)node_index);
+				errno = EBADMSG;
+				goto ERROR;
+			}
+
+			if (children[i] >= count) {
+				ERROR(db->ctx, "Node %jd points to node %u which does not exist\n",
+					(intmax_t)node_index, children[i]);
+				errno = EBADMSG;
+				goto ERROR;
+			}
+
+			// Since the depth is limited, the stack cannot overflow
+			stack[depth++] = (struct loc_node_stack){
+				.offset = children[i],
+				.i      = i,
+				.depth  = level + 1,
+			};
+		}
+	}
+
+	r = 0;
+
+ERROR:
+	free(visited);
+
+	return r;
+}
+
+LOC_EXPORT int loc_database_validate(struct loc_database* db) {
+	int r;
+
+	// Nothing to do if this has already been done
+	if (db->validated)
+		return 0;
+
+	clock_t start = clock();
+
+	// All objects must be within the file
+	r = loc_database_validate_objects(db, &db->as_objects, "ASes");
+	if (r)
+		return r;
+
+	r = loc_database_validate_objects(db, &db->network_node_objects, "network nodes");
+	if (r)
+		return r;
+
+	r = loc_database_validate_objects(db, &db->network_objects, "networks");
+	if (r)
+		return r;
+
+	r = loc_database_validate_objects(db, &db->country_objects, "countries");
+	if (r)
+		return r;
+
+	// Check the network tree
+	r = loc_database_validate_tree(db);
+	if (r)
+		return r;
+
+	clock_t end = clock();
+
+	INFO(db->ctx, "Validated database in %.4fms\n",
+		(double)(end - start) / CLOCKS_PER_SEC * 1000);
+
+	db->validated = 1;
+
+	return 0;
+}
+
+// Returns the country at position pos
+static int loc_database_fetch_country(struct loc_database* db,
+		struct loc_country** country, off_t pos) {
+	struct loc_database_country_v1* country_v1 = NULL;
+	int r;
+
+	// Check if the country is within range
+	if ((size_t)pos >= db->country_objects.count) {
+		errno = ERANGE;
+		return 1;
+	}
+
+	// Return the shared object if it exists
+	*country = atomic_load(&db->interned_countries[pos]);
+	if (*country) {
+		loc_country_ref(*country);
+		return 0;
+	}
+
+	DEBUG(db->ctx, "Fetching country at position %jd\n", (intmax_t)pos);
+
+	switch (db->version) {
+		case LOC_DATABASE_VERSION_1:
+			// Read the object
+			country_v1 = (struct loc_database_country_v1*)loc_database_object(db,
+				&db->country_objects, sizeof(*country_v1), pos);
+			if (!country_v1)
+				return 1;
+
+			r = loc_country_new_from_database_v1(db->ctx, db->pool, country, country_v1);
+			break;
+
+		default:
+			errno = ENOTSUP;
+			return 1;
+	}
+
+	if (r)
+		return r;
+
+	DEBUG(db->ctx, "Got country %s\n", loc_country_get_code(*country));
+
+	// Share the object unless another thread has been faster
+	struct loc_country* other = NULL;
+
+	loc_country_set_readonly(*country);
+
+	if (atomic_compare_exchange_strong(&db->interned_countries[pos], &other, *country)) {
+		// Keep a reference for the database
+		loc_country_ref(*country);
+	} else {
+		loc_country_unref(*country);
+		*country = loc_country_ref(other);
+	}
+
+	return 0;
+}
+
+LOC_EXPORT int loc_database_get_country(struct loc_database* db,
+		struct loc_country** country, const char* code) {
+	// Check if the country code is valid
+	if (!loc_country_code_is_valid(code)) {
+		errno = EINVAL;
+		return 1;
+	}
+
+	*country = NULL;
+
+	// Find the country in the index
+	const uint32_t pos = db->country_index[LOC_DATABASE_COUNTRY_INDEX(code)];
+
+	// Nothing found
+	if (!pos)
+		return 0;
+
+	return loc_database_fetch_country(db, country, pos - 1);
+}
+
+// Enumerator
+
+static void loc_database_enumerator_free(struct loc_database_enumerator* enumerator) {
+	DEBUG(enumerator->ctx, "Releasing database enumerator %p\n", enumerator);
+
+	// Release all references
+	loc_database_unref(enumerator->db);
+	loc_unref(enumerator->ctx);
+
+	if (enumerator->string)
+		free(enumerator->string);
+
+	if (enumerator->countries)
+		loc_country_list_unref(enumerator->countries);
+
+	if (enumerator->asns)
+		loc_as_list_unref(enumerator->asns);
+
+	if (enumerator->filter_asns)
+		free(enumerator->filter_asns);
+
+	if (enumerator->runs)
+		free(enumerator->runs);
+
+	if (enumerator->enclosing)
+		free(enumerator->enclosing);
+
+	// Free network search
+	if (enumerator->networks_visited)
+		free(enumerator->networks_visited);
+
+	// Free bogons stack
+	if (enumerator->stack)
+		loc_network_list_unref(enumerator->stack);
+
+	free(enumerator);
+}
+
+LOC_EXPORT int loc_database_enumerator_new(struct loc_database_enumerator** enumerator,
+		struct loc_database* db, enum loc_database_enumerator_mode mode, int flags) {
+	int r;
+
+	struct loc_database_enumerator* e = calloc(1, sizeof(*e));
+	if (!e) {
+		return -ENOMEM;
+	}
+
+	// Reference context
+	e->ctx = loc_ref(db->ctx);
+	e->db = loc_database_ref(db);
+	e->mode = mode;
 	e->refcount = 1;
 
 	// Flatten output?
 	e->flatten = (flags & LOC_DB_ENUMERATOR_FLAGS_FLATTEN);
 
+	// Return enclosing networks?
+	e->supernets = (flags & LOC_DB_ENUMERATOR_FLAGS_SUPERNETS);
+
 	// Initialise graph search
 	e->network_stack_depth = 1;
-	e->networks_visited = calloc(db->network_node_objects.count, sizeof(*e->networks_visited));
-	if (!e->networks_visited) {
-		ERROR(db->ctx, "Could not allocated visited networks: %m\n");
-		r = 1;
+
+	// Allocate stack
+	r = loc_network_list_new(e->ctx, &e->stack);
+	if (r)
 		goto ERROR;
+
+	// Initialize bogon search
+	loc_address_reset(&e->gap6_start, AF_INET6);
+	loc_address_reset(&e->gap4_start, AF_INET);
+
+	DEBUG(e->ctx, "Database enumerator object allocated at %p\n", e);
+
+	*enumerator = e;
+	return 0;
+
+ERROR:
+	if (e)
+		loc_database_enumerator_free(e);
+
+	return r;
+}
+
+LOC_EXPORT struct loc_database_enumerator* loc_database_enumerator_ref(struct loc_database_enumerator* enumerator) {
+	enumerator->refcount++;
+
+	return enumerator;
+}
+
+LOC_EXPORT struct loc_database_enumerator* loc_database_enumerator_unref(struct loc_database_enumerator* enumerator) {
+	if (!enumerator)
+		return NULL;
+
+	if (--enumerator->refcount > 0)
+		return enumerator;
+
+	loc_database_enumerator_free(enumerator);
+	return NULL;
+}
+
+LOC_EXPORT int loc_database_enumerator_set_string(struct loc_database_enumerator* enumerator, const char* string) {
+	if (enumerator->string)
+		free(enumerator->string);
+
+	enumerator->string = strdup(string);
+
+	// Make the string lowercase
+	for (char *p = enumerator->string; *p; p++)
+		*p = tolower(*p);
+
+	// Search for candidates again
+	enumerator->as_candidates = NULL;
+	enumerator->as_candidates_count = 0;
+	enumerator->as_candidates_ready = 0;
+	enumerator->as_index = 0;
+
+	return 0;
+}
+
+LOC_EXPORT struct loc_country_list* loc_database_enumerator_get_countries(
+		struct loc_database_enumerator* enumerator) {
+	if (!enumerator->countries)
+		return NULL;
+
+	return loc_country_list_ref(enumerator->countries);
+}
+
+LOC_EXPORT int loc_database_enumerator_set_countries(
+		struct loc_database_enumerator* enumerator, struct loc_country_list* countries) {
+	if (enumerator->countries)
+		loc_country_list_unref(enumerator->countries);
+
+	enumerator->countries = loc_country_list_ref(countries);
+
+	// Compile the filter again
+	enumerator->filter_ready = 0;
+
+	return 0;
+}
+
+LOC_EXPORT struct loc_as_list* loc_database_enumerator_get_asns(
+		struct loc_database_enumerator* enumerator) {
+	if (!enumerator->asns)
+		return NULL;
+
+	return loc_as_list_ref(enumerator->asns);
+}
+
+LOC_EXPORT int loc_database_enumerator_set_asns(
+		struct loc_database_enumerator* enumerator, struct loc_as_list* asns) {
+	if (enumerator->asns)
+		loc_as_list_unref(enumerator->asns);
+
+	enumerator->asns = loc_as_list_ref(asns);
+
+	// Compile the filter again
+	enumerator->filter_ready = 0;
+
+	return 0;
+}
+
+LOC_EXPORT int loc_database_enumerator_set_flag(
+		struct loc_database_enumerator* enumerator, enum loc_network_flags flag) {
+	enumerator->flags |= flag;
+
+	return 0;
+}
+
+LOC_EXPORT int loc_database_enumerator_set_family(
+		struct loc_database_enumerator* enumerator, int family) {
+	enumerator->family = family;
+
+	return 0;
+}
+
+LOC_EXPORT int loc_database_enumerator_set_range(struct loc_database_enumerator* enumerator,
+		const struct in6_addr* first_address, const struct in6_addr* last_address) {
+	// Ranges are only supported for networks
+	if (enumerator->mode != LOC_DB_ENUMERATE_NETWORKS) {
+		errno = ENOTSUP;
+		return 1;
+	}
+
+	// The enumerator must not have started, yet
+	if (enumerator->runs_ready) {
+		errno = EBUSY;
+		return 1;
+	}
+
+	// The range has already been set by the subtree
+	if (enumerator->subtree) {
+		errno = EBUSY;
+		return 1;
+	}
+
+	// The range must not be empty
+	if (loc_address_cmp(first_address, last_address) > 0) {
+		errno = EINVAL;
+		return 1;
+	}
+
+	enumerator->range_first = *first_address;
+	enumerator->range_last  = *last_address;
+	enumerator->range = 1;
+
+	return 0;
+}
+
+LOC_EXPORT int loc_database_enumerator_set_network(
+		struct loc_database_enumerator* enumerator, struct loc_network* network) {
+	struct loc_database* db = enumerator->db;
+	struct loc_database_node node;
+	off_t offset = 0;
+	unsigned int depth = 0;
+	int r;
+
+	// Subtrees are only supported for networks
+	if (enumerator->mode != LOC_DB_ENUMERATE_NETWORKS) {
+		errno = ENOTSUP;
+		return 1;
+	}
+
+	// The enumerator must not have started, yet
+	if (enumerator->runs_ready || enumerator->range) {
+		errno = EBUSY;
+		return 1;
+	}
+
+	const struct in6_addr* address = loc_network_get_first_address(network);
+	const unsigned int prefix = loc_network_raw_prefix(network);
+
+	// Remember the enclosing networks if we need them
+	if (enumerator->supernets || enumerator->flatten) {
+		enumerator->enclosing = calloc(prefix + 1, sizeof(*enumerator->enclosing));
+		if (!enumerator->enclosing)
+			return 1;
+	}
+
+	// Descend the tree until we have found the network
+	for (;;) {
+		r = loc_database_read_node(db, offset, &node, loc_database_access(db));
+		if (r)
+			goto ERROR;
+
+		if (depth == prefix)
+			break;
+
+		if (enumerator->enclosing && node.network != LOC_DATABASE_NO_NETWORK) {
+			const struct in6_addr bitmask = loc_prefix_to_bitmask(depth);
+
+			enumerator->enclosing[enumerator->enclosing_count++] = (struct loc_database_enumerator_hit){
+				.address = loc_address_and(address, &bitmask),
+				.prefix  = depth,
+				.network = node.network,
+			};
+		}
+
+		offset = node.children[loc_address_get_bit(address, depth++)];
+
+		// The tree ends before we have reached the network
+		if (!offset)
+			break;
+	}
+
+	DEBUG(enumerator->ctx, "Found %zu network(s) enclosing %s\n",
+		enumerator->enclosing_count, loc_network_str(network));
+
+	// Start walking at the network
+	enumerator->network_address = *address;
+
+	if (depth == prefix) {
+		enumerator->network_stack[1] = (struct loc_node_stack){
+			.offset = offset,
+			.i      = (depth > 0) ? loc_address_get_bit(address, depth - 1) : 0,
+			.depth  = depth,
+		};
+		enumerator->network_stack_depth = 1;
+	} else {
+		enumerator->network_stack_depth = 0;
+	}
+
+	// Only return what is inside the network
+	enumerator->range_first = *address;
+	enumerator->range_last  = *loc_network_get_last_address(network);
+	enumerator->range = 1;
+
+	enumerator->subtree = 1;
+
+	return 0;
+
+ERROR:
+	if (enumerator->enclosing) {
+		free(enumerator->enclosing);
+		enumerator->enclosing = NULL;
+	}
+	enumerator->enclosing_count = 0;
+
+	return r;
+}
+
+static uint64_t loc_database_cursor_hash(uint64_t hash, uint64_t value) {
+	return (hash ^ value) * 0x9e3779b97f4a7c15;
+}
+
+/*
+	Computes a fingerprint of the database and everything that changes which
+	networks the enumerator returns, so that a cursor cannot be used with another one
+*/
+static uint32_t loc_database_enumerator_fingerprint(struct loc_database_enumerator* enumerator) {
+	uint64_t countries = 0;
+	uint64_t asns = 0;
+	uint64_t hash = 0;
+
+	hash = loc_database_cursor_hash(hash, enumerator->db->created_at);
+	hash = loc_database_cursor_hash(hash, enumerator->db->network_node_objects.count);
+	hash = loc_database_cursor_hash(hash, enumerator->mode);
+	hash = loc_database_cursor_hash(hash, !!enumerator->flatten);
+	hash = loc_database_cursor_hash(hash, !!enumerator->supernets);
+	hash = loc_database_cursor_hash(hash, enumerator->flags);
+	hash = loc_database_cursor_hash(hash, enumerator->family);
+
+	// The order of the lists does not matter
+	if (enumerator->countries) {
+		for (size_t i = 0; i < loc_country_list_size(enumerator->countries); i++) {
+			struct loc_country* country = loc_country_list_get(enumerator->countries, i);
+			const char* code = loc_country_get_code(country);
+
+			countries += loc_database_cursor_hash(0, (code[0] << 8) | code[1]);
+			loc_country_unref(country);
+		}
+	}
+
+	if (enumerator->asns) {
+		for (size_t i = 0; i < loc_as_list_size(enumerator->asns); i++) {
+			struct loc_as* as = loc_as_list_get(enumerator->asns, i);
+
+			asns += loc_database_cursor_hash(0, loc_as_get_number(as));
+			loc_as_unref(as);
+		}
+	}
+
+	hash = loc_database_cursor_hash(hash, countries);
+	hash = loc_database_cursor_hash(hash, asns);
+
+	if (enumerator->range) {
+		for (unsigned int i = 0; i < 4; i++) {
+			hash = loc_database_cursor_hash(hash, enumerator->range_first.s6_addr32[i]);
+			hash = loc_database_cursor_hash(hash, enumerator->range_last.s6_addr32[i]);
+		}
+	}
+
+	return hash >> 32;
+}
+
+LOC_EXPORT int loc_database_enumerator_get_cursor(struct loc_database_enumerator* enumerator,
+		char* cursor, size_t length) {
+	unsigned char buffer[LOC_DATABASE_CURSOR_SIZE];
+	const char* digits = "0123456789abcdef";
+
+	// Cursors are only supported for networks
+	if (enumerator->mode != LOC_DB_ENUMERATE_NETWORKS) {
+		errno = ENOTSUP;
+		return 1;
+	}
+
+	if (length < LOC_DATABASE_CURSOR_LENGTH) {
+		errno = ERANGE;
+		return 1;
+	}
+
+	// The fingerprint is fixed once the enumerator has started
+	const uint32_t fingerprint = htobe32((enumerator->runs_ready) ?
+		enumerator->fingerprint : loc_database_enumerator_fingerprint(enumerator));
+
+	buffer[0] = LOC_DATABASE_CURSOR_VERSION;
+	buffer[1] = enumerator->position;
+	buffer[2] = enumerator->position_prefix;
+	memcpy(buffer + 3, &enumerator->position_address, 16);
+	memcpy(buffer + 19, &fingerprint, 4);
+
+	for (unsigned int i = 0; i < sizeof(buffer); i++) {
+		*cursor++ = digits[buffer[i] >> 4];
+		*cursor++ = digits[buffer[i] & 0x0f];
+	}
+
+	*cursor = '\0';
+
+	return 0;
+}
+
+static int loc_database_cursor_digit(char c) {
+	if (c >= '0' && c <= '9')
+		return c - '0';
+
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+
+	return -1;
+}
+
+LOC_EXPORT int loc_database_enumerator_set_cursor(struct loc_database_enumerator* enumerator,
+		const char* cursor) {
+	unsigned char buffer[LOC_DATABASE_CURSOR_SIZE];
+	struct in6_addr address;
+	uint32_t fingerprint;
+
+	// Cursors are only supported for networks
+	if (enumerator->mode != LOC_DB_ENUMERATE_NETWORKS) {
+		errno = ENOTSUP;
+		return 1;
+	}
+
+	// The enumerator must not have started, yet
+	if (enumerator->runs_ready) {
+		errno = EBUSY;
+		return 1;
+	}
+
+	if (strlen(cursor) != LOC_DATABASE_CURSOR_LENGTH - 1)
+		goto INVALID;
+
+	for (unsigned int i = 0; i < sizeof(buffer); i++) {
+		const int high = loc_database_cursor_digit(cursor[i * 2]);
+		const int low  = loc_database_cursor_digit(cursor[i * 2 + 1]);
+
+		if (high < 0 || low < 0)
+			goto INVALID;
+
+		buffer[i] = (high << 4) | low;
 	}
 
-	// Allocate stack
-	r = loc_network_list_new(e->ctx, &e->stack);
-	if (r)
-		goto ERROR;
+	memcpy(&address, buffer + 3, 16);
+	memcpy(&fingerprint, buffer + 19, 4);
+
+	if (buffer[0] != LOC_DATABASE_CURSOR_VERSION)
+		goto INVALID;
+
+	if (buffer[1] > LOC_DATABASE_CURSOR_END || buffer[2] > 128)
+		goto INVALID;
 
-	// Initialize bogon search
-	loc_address_reset(&e->gap6_start, AF_INET6);
-	loc_address_reset(&e->gap4_start, AF_INET);
+	// The cursor must belong to the same database and filter
+	if (be32toh(fingerprint) != loc_database_enumerator_fingerprint(enumerator)) {
+		DEBUG(enumerator->ctx, "The cursor belongs to a different enumerator\n");
+		goto INVALID;
+	}
 
-	DEBUG(e->ctx, "Database enumerator object allocated at %p\n", e);
+	enumerator->cursor         = buffer[1];
+	enumerator->cursor_address = address;
+	enumerator->cursor_prefix  = buffer[2];
 
-	*enumerator = e;
 	return 0;
 
-ERROR:
-	if (e)
-		loc_database_enumerator_free(e);
-
-	return r;
+INVALID:
+	errno = EINVAL;
+	return 1;
 }
 
-LOC_EXPORT struct loc_database_enumerator* loc_database_enumerator_ref(struct loc_database_enumerator* enumerator) {
-	enumerator->refcount++;
+/*
+	Moves the start of the range behind the position of the cursor
+*/
+static void loc_database_enumerator_seek(struct loc_database_enumerator* enumerator) {
+	struct in6_addr first_address = enumerator->cursor_address;
 
-	return enumerator;
-}
+	if (enumerator->cursor != LOC_DATABASE_CURSOR_AFTER)
+		return;
 
-LOC_EXPORT struct loc_database_enumerator* loc_database_enumerator_unref(struct loc_database_enumerator* enumerator) {
-	if (!enumerator)
-		return NULL;
+	// Flattened networks do not overlap, so we can continue after the last one
+	if (enumerator->flatten) {
+		const struct in6_addr bitmask = loc_prefix_to_bitmask(enumerator->cursor_prefix);
 
-	if (--enumerator->refcount > 0)
-		return enumerator;
+		first_address = loc_address_or(&first_address, &bitmask);
 
-	loc_database_enumerator_free(enumerator);
-	return NULL;
-}
+		if (loc_address_all_ones(&first_address)) {
+			enumerator->cursor = LOC_DATABASE_CURSOR_END;
+			return;
+		}
 
-LOC_EXPORT int loc_database_enumerator_set_string(struct loc_database_enumerator* enumerator, const char* string) {
-	enumerator->string = strdup(string);
+		loc_address_increment(&first_address);
+	}
 
-	// Make the string lowercase
-	for (char *p = enumerator->string; *p; p++)
-		*p = tolower(*p);
+	if (!enumerator->range) {
+		memset(&enumerator->range_last, 0xff, sizeof(enumerator->range_last));
+		enumerator->range = 1;
+		enumerator->range_cursor = 1;
 
-	return 0;
-}
+	// Keep the start of the range if it comes later
+	} else if (loc_address_cmp(&first_address, &enumerator->range_first) < 0) {
+		return;
+	}
 
-LOC_EXPORT struct loc_country_list* loc_database_enumerator_get_countries(
-		struct loc_database_enumerator* enumerator) {
-	if (!enumerator->countries)
-		return NULL;
+	enumerator->range_first = first_address;
 
-	return loc_country_list_ref(enumerator->countries);
+	// Nothing is left in the range
+	if (loc_address_cmp(&enumerator->range_first, &enumerator->range_last) > 0)
+		enumerator->cursor = LOC_DATABASE_CURSOR_END;
 }
 
-LOC_EXPORT int loc_database_enumerator_set_countries(
-		struct loc_database_enumerator* enumerator, struct loc_country_list* countries) {
-	if (enumerator->countries)
-		loc_country_list_unref(enumerator->countries);
+/*
+	Checks whether the network (or subtree) at address/prefix overlaps with the range
+	and sets inside if it is entirely inside of it
+*/
+static int loc_database_enumerator_range_overlaps(struct loc_database_enumerator* enumerator,
+		const struct in6_addr* address, unsigned int prefix, int* inside) {
+	const struct in6_addr bitmask = loc_prefix_to_bitmask(prefix);
 
-	enumerator->countries = loc_country_list_ref(countries);
+	const struct in6_addr first_address = loc_address_and(address, &bitmask);
+	if (loc_address_cmp(&first_address, &enumerator->range_last) > 0)
+		return 0;
 
-	return 0;
-}
+	const struct in6_addr last_address = loc_address_or(address, &bitmask);
+	if (loc_address_cmp(&last_address, &enumerator->range_first) < 0)
+		return 0;
 
-LOC_EXPORT struct loc_as_list* loc_database_enumerator_get_asns(
-		struct loc_database_enumerator* enumerator) {
-	if (!enumerator->asns)
-		return NULL;
+	if (inside)
+		*inside = loc_address_cmp(&first_address, &enumerator->range_first) >= 0
+			&& loc_address_cmp(&last_address, &enumerator->range_last) <= 0;
 
-	return loc_as_list_ref(enumerator->asns);
+	return 1;
 }
 
-LOC_EXPORT int loc_database_enumerator_set_asns(
-		struct loc_database_enumerator* enumerator, struct loc_as_list* asns) {
-	if (enumerator->asns)
-		loc_as_list_unref(enumerator->asns);
+/*
+	Checks whether the network at address/prefix starts inside the range
+*/
+static int loc_database_enumerator_range_contains(struct loc_database_enumerator* enumerator,
+		const struct in6_addr* address, unsigned int prefix) {
+	const struct in6_addr bitmask = loc_prefix_to_bitmask(prefix);
 
-	enumerator->asns = loc_as_list_ref(asns);
+	const struct in6_addr first_address = loc_address_and(address, &bitmask);
 
-	return 0;
+	return loc_address_cmp(&first_address, &enumerator->range_first) >= 0
+		&& loc_address_cmp(&first_address, &enumerator->range_last) <= 0;
 }
 
-LOC_EXPORT int loc_database_enumerator_set_flag(
-		struct loc_database_enumerator* enumerator, enum loc_network_flags flag) {
-	enumerator->flags |= flag;
+/*
+	Finds the ASes whose names might contain the search string in the AS name index
+*/
+static int loc_database_enumerator_find_as_candidates(struct loc_database_enumerator* enumerator) {
+	const struct loc_database_as_name_index* index = NULL;
+	int r;
 
-	return 0;
-}
+	// Strings without a trigram need to be searched for in all ASes
+	if (!enumerator->string || strlen(enumerator->string) < 3)
+		return 0;
 
-LOC_EXPORT int loc_database_enumerator_set_family(
-		struct loc_database_enumerator* enumerator, int family) {
-	enumerator->family = family;
+	r = loc_database_build_as_name_index(enumerator->db);
+	if (r)
+		return r;
+
+	index = atomic_load(&enumerator->db->as_name_index);
+
+	// Any match contains all trigrams of the string so the shortest list will do
+	for (const char* p = enumerator->string; p[2]; p++) {
+		const uint32_t bucket = loc_database_as_name_bucket(p);
+		const size_t count = index->offsets[bucket + 1] - index->offsets[bucket];
+
+		if (!enumerator->as_candidates || count < enumerator->as_candidates_count) {
+			enumerator->as_candidates = index->ases + index->offsets[bucket];
+			enumerator->as_candidates_count = count;
+		}
+	}
+
+	DEBUG(enumerator->ctx, "Found %zu candidates for %s\n",
+		enumerator->as_candidates_count, enumerator->string);
 
 	return 0;
 }
 
 LOC_EXPORT int loc_database_enumerator_next_as(
 		struct loc_database_enumerator* enumerator, struct loc_as** as) {
+	off_t pos = 0;
+	int r;
+
 	*as = NULL;
 
 	// Do not do anything if not in AS mode
@@ -1228,23 +3481,37 @@ LOC_EXPORT int loc_database_enumerator_next_as(
 
 	struct loc_database* db = enumerator->db;
 
-	while (enumerator->as_index < db->as_objects.count) {
-		// Fetch the next AS
-		int r = loc_database_fetch_as(db, as, enumerator->as_index++);
+	// Look up the candidates on the first call
+	if (!enumerator->as_candidates_ready) {
+		r = loc_database_enumerator_find_as_candidates(enumerator);
 		if (r)
 			return r;
 
-		r = loc_as_match_string(*as, enumerator->string);
-		if (r == 1) {
-			DEBUG(enumerator->ctx, "AS%u (%s) matches %s\n",
-				loc_as_get_number(*as), loc_as_get_name(*as), enumerator->string);
+		enumerator->as_candidates_ready = 1;
+	}
 
-			return 0;
-		}
+	// Walk through the candidates or through all ASes
+	const size_t count = (enumerator->as_candidates) ?
+		enumerator->as_candidates_count : db->as_objects.count;
 
-		// No match
-		loc_as_unref(*as);
-		*as = NULL;
+	while (enumerator->as_index < count) {
+		if (enumerator->as_candidates)
+			pos = enumerator->as_candidates[enumerator->as_index++];
+		else
+			pos = enumerator->as_index++;
+
+		// Only create an object for a match
+		if (!loc_database_as_name_matches(db, pos, enumerator->string))
+			continue;
+
+		r = loc_database_fetch_as(db, as, pos);
+		if (r)
+			return r;
+
+		DEBUG(enumerator->ctx, "AS%u (%s) matches %s\n",
+			loc_as_get_number(*as), loc_as_get_name(*as), enumerator->string);
+
+		return 0;
 	}
 
 	// Reset the index
@@ -1255,7 +3522,7 @@ LOC_EXPORT int loc_database_enumerator_next_as(
 }
 
 static int loc_database_enumerator_stack_push_node(
-		struct loc_database_enumerator* e, off_t offset, int i, int depth) {
+		struct loc_database_enumerator* e, off_t offset, int i, int depth, int inside) {
 	// Do not add empty nodes
 	if (!offset)
 		return 0;
@@ -1267,7 +3534,7 @@ static int loc_database_enumerator_stack_push_node(
 	}
 
 	// Check if the node is in range
-	if (offset >= (off_t)e->db->network_node_objects.count) {
+	if (!e->db->validated && offset >= (off_t)e->db->network_node_objects.count) {
 		ERROR(e->ctx, "Trying to add invalid node with offset %jd/%zu\n",
 			offset, e->db->network_node_objects.count);
 		errno = ERANGE;
@@ -1282,247 +3549,637 @@ static int loc_database_enumerator_stack_push_node(
 	e->network_stack[s].offset = offset;
 	e->network_stack[s].i = i;
 	e->network_stack[s].depth = depth;
+	e->network_stack[s].inside = inside;
 
 	return 0;
 }
 
-static int loc_database_enumerator_match_network(
-		struct loc_database_enumerator* enumerator, struct loc_network* network) {
+static int loc_database_enumerator_cmp_asn(const void* p1, const void* p2) {
+	const uint32_t asn1 = *(const uint32_t*)p1;
+	const uint32_t asn2 = *(const uint32_t*)p2;
+
+	if (asn1 < asn2)
+		return -1;
+
+	return asn1 > asn2;
+}
+
+/*
+	Turns the countries and ASNs into a bitmap and a sorted array
+	so that matching networks does not need to search any lists
+*/
+static int loc_database_enumerator_compile_filter(struct loc_database_enumerator* enumerator) {
+	struct loc_country* country = NULL;
+	struct loc_as* as = NULL;
+
+	memset(enumerator->filter_countries, 0, sizeof(enumerator->filter_countries));
+
+	if (enumerator->filter_asns) {
+		free(enumerator->filter_asns);
+		enumerator->filter_asns = NULL;
+	}
+	enumerator->filter_asns_count = 0;
+
+	// Countries (all codes are valid)
+	if (enumerator->countries) {
+		for (size_t i = 0; i < loc_country_list_size(enumerator->countries); i++) {
+			country = loc_country_list_get(enumerator->countries, i);
+
+			const unsigned int index = LOC_DATABASE_COUNTRY_INDEX(loc_country_get_code(country));
+			enumerator->filter_countries[index / 64] |= (uint64_t)1 << (index % 64);
+
+			loc_country_unref(country);
+		}
+	}
+
+	// ASNs
+	if (enumerator->asns && !loc_as_list_empty(enumerator->asns)) {
+		const size_t length = loc_as_list_size(enumerator->asns);
+
+		enumerator->filter_asns = calloc(length, sizeof(*enumerator->filter_asns));
+		if (!enumerator->filter_asns)
+			return 1;
+
+		for (size_t i = 0; i < length; i++) {
+			as = loc_as_list_get(enumerator->asns, i);
+
+			enumerator->filter_asns[enumerator->filter_asns_count++] = loc_as_get_number(as);
+
+			loc_as_unref(as);
+		}
+
+		qsort(enumerator->filter_asns, enumerator->filter_asns_count,
+			sizeof(*enumerator->filter_asns), loc_database_enumerator_cmp_asn);
+	}
+
+	enumerator->filter_ready = 1;
+
+	return 0;
+}
+
+/*
+	Checks whether a network with these properties matches the filter
+*/
+static int loc_database_enumerator_match(struct loc_database_enumerator* enumerator,
+		int family, const char* country_code, uint32_t asn, uint16_t flags) {
 	// If family is set, it must match
-	if (enumerator->family && loc_network_address_family(network) != enumerator->family) {
-		DEBUG(enumerator->ctx, "Filtered network %p because of family not matching\n", network);
+	if (enumerator->family && family != enumerator->family)
 		return 0;
-	}
 
 	// Match if no filter criteria is configured
 	if (!enumerator->countries && !enumerator->asns && !enumerator->flags)
 		return 1;
 
 	// Check if the country code matches
-	if (enumerator->countries && !loc_country_list_empty(enumerator->countries)) {
-		const char* country_code = loc_network_get_country_code(network);
+	if (country_code[0] >= 'A' && country_code[0] <= 'Z'
+			&& country_code[1] >= 'A' && country_code[1] <= 'Z') {
+		const unsigned int index = LOC_DATABASE_COUNTRY_INDEX(country_code);
 
-		if (loc_country_list_contains_code(enumerator->countries, country_code)) {
-			DEBUG(enumerator->ctx, "Matched network %p because of its country code\n", network);
+		if (enumerator->filter_countries[index / 64] & ((uint64_t)1 << (index % 64)))
 			return 1;
-		}
 	}
 
 	// Check if the ASN matches
-	if (enumerator->asns && !loc_as_list_empty(enumerator->asns)) {
-		uint32_t asn = loc_network_get_asn(network);
+	if (enumerator->filter_asns_count && bsearch(&asn, enumerator->filter_asns,
+			enumerator->filter_asns_count, sizeof(*enumerator->filter_asns),
+			loc_database_enumerator_cmp_asn))
+		return 1;
 
-		if (loc_as_list_contains_number(enumerator->asns, asn)) {
-			DEBUG(enumerator->ctx, "Matched network %p because of its ASN\n", network);
-			return 1;
+	// Check if flags match
+	if (enumerator->flags & flags)
+		return 1;
+
+	// Not a match
+	return 0;
+}
+
+/*
+	Returns the first entry in a run with an address greater than or equal to
+	(or greater than, if after is set) address
+*/
+static const struct loc_database_network_index_entry_v1* loc_database_network_index_search(
+		const struct loc_database_network_index_entry_v1* first,
+		const struct loc_database_network_index_entry_v1* last,
+		const struct in6_addr* address, int after) {
+	while (first < last) {
+		const struct loc_database_network_index_entry_v1* middle = first + (last - first) / 2;
+
+		const int r = memcmp(middle->address, address, sizeof(middle->address));
+
+		if (r < 0 || (after && r == 0))
+			first = middle + 1;
+		else
+			last = middle;
+	}
+
+	return first;
+}
+
+static int loc_database_network_index_entry_cmp(
+		const struct loc_database_network_index_entry_v1* entry1,
+		const struct loc_database_network_index_entry_v1* entry2) {
+	int r = memcmp(entry1->address, entry2->address, sizeof(entry1->address));
+	if (r)
+		return r;
+
+	return (int)entry1->prefix - (int)entry2->prefix;
+}
+
+/*
+	The runs are kept in a heap so that the run that continues with the
+	lowest address is always at the top
+*/
+static void loc_database_enumerator_sift_run(
+		struct loc_database_enumerator* enumerator, size_t i) {
+	struct loc_database_enumerator_run* runs = enumerator->runs;
+	struct loc_database_enumerator_run run;
+
+	for (;;) {
+		size_t lowest = i;
+
+		for (size_t child = 2 * i + 1; child <= 2 * i + 2; child++) {
+			if (child < enumerator->runs_count
+					&& loc_database_network_index_entry_cmp(runs[child].next, runs[lowest].next) < 0)
+				lowest = child;
 		}
+
+		if (lowest == i)
+			break;
+
+		run = runs[i];
+		runs[i] = runs[lowest];
+		runs[lowest] = run;
+
+		i = lowest;
 	}
+}
 
-	// Check if flags match
-	if (enumerator->flags && loc_network_has_flag(network, enumerator->flags)) {
-		DEBUG(enumerator->ctx, "Matched network %p because of its flags\n", network);
+/*
+	Finds the runs of networks in the network indexes that hold all networks
+	that the enumerator is looking for, if there are any
+*/
+static int loc_database_enumerator_find_runs(struct loc_database_enumerator* enumerator) {
+	const struct loc_database_network_index* index = NULL;
+	struct loc_database* db = enumerator->db;
+	struct loc_database_enumerator_run* run = NULL;
+	struct loc_country* country = NULL;
+	struct loc_as* as = NULL;
+	size_t length = 0;
+	size_t count = 0;
+	uint32_t key = 0;
+	int r;
+
+	if (enumerator->mode != LOC_DB_ENUMERATE_NETWORKS || enumerator->flags || enumerator->subtree)
+		return 0;
+
+	const int countries = enumerator->countries && !loc_country_list_empty(enumerator->countries);
+	const int asns = enumerator->asns && !loc_as_list_empty(enumerator->asns);
+
+	// Searches for ASNs alone can use the networks of each AS
+	if (asns && !countries && !enumerator->flatten) {
+		index = &db->as_networks;
+		length = loc_as_list_size(enumerator->asns);
+
+	// Flattened searches for countries alone can use the flattened networks of each country
+	// (but those are not cut at the edges of a range, which does not matter when the range
+	// only skips everything up to a cursor, because flattened networks don't overlap)
+	} else if (countries && !asns && enumerator->flatten
+			&& (!enumerator->range || enumerator->range_cursor)) {
+		index = &db->country_networks;
+		length = loc_country_list_size(enumerator->countries);
+
+	} else {
+		return 0;
+	}
+
+	// Does the database have the index?
+	if (!index->keys)
+		return 0;
+
+	enumerator->runs = calloc(length, sizeof(*enumerator->runs));
+	if (!enumerator->runs)
 		return 1;
+
+	for (unsigned int i = 0; i < length; i++) {
+		if (asns) {
+			as = loc_as_list_get(enumerator->asns, i);
+
+			key = loc_as_get_number(as);
+			loc_as_unref(as);
+		} else {
+			country = loc_country_list_get(enumerator->countries, i);
+
+			key = LOC_DATABASE_COUNTRY_KEY(loc_country_get_code(country));
+			loc_country_unref(country);
+		}
+
+		run = &enumerator->runs[enumerator->runs_count];
+
+		r = loc_database_network_index_find(index, key, &run->next, &count);
+		if (r)
+			return r;
+
+		run->end = run->next + count;
+
+		// Skip anything outside of the range
+		if (enumerator->range) {
+			run->next = loc_database_network_index_search(run->next, run->end,
+				&enumerator->range_first, 0);
+			run->end = loc_database_network_index_search(run->next, run->end,
+				&enumerator->range_last, 1);
+		}
+
+		if (run->next >= run->end)
+			continue;
+
+		enumerator->runs_count++;
 	}
 
-	// Not a match
+	// Order the runs
+	for (size_t i = enumerator->runs_count / 2; i-- > 0;)
+		loc_database_enumerator_sift_run(enumerator, i);
+
+	DEBUG(enumerator->ctx, "Found %zu run(s) in the network index\n", enumerator->runs_count);
+
 	return 0;
 }
 
-static int __loc_database_enumerator_next_network(
-		struct loc_database_enumerator* enumerator, struct loc_network** network, int filter) {
-	// Return top element from the stack
-	while (1) {
-		*network = loc_network_list_pop_first(enumerator->stack);
+/*
+	Checks whether the network that has been found matches the filter
+	without creating an object for it
+*/
+static int loc_database_enumerator_match_hit(struct loc_database_enumerator* enumerator,
+		const struct loc_database_enumerator_hit* hit) {
+	struct loc_database_network properties;
+	char country_code[3] = "\0\0";
+	int r;
 
-		// Stack is empty
-		if (!*network)
-			break;
+	r = loc_database_read_network(enumerator->db, hit->network, &properties);
+	if (r)
+		return -1;
 
-		// Return everything if filter isn't enabled, or only return matches
-		if (!filter || loc_database_enumerator_match_network(enumerator, *network))
+	loc_country_code_copy(country_code, properties.country_code);
+
+	// Networks are IPv4 when they are inside ::ffff:0:0/96
+	const int family = (hit->prefix >= 96
+		&& IN6_IS_ADDR_V4MAPPED(&hit->address)) ? AF_INET : AF_INET6;
+
+	return loc_database_enumerator_match(enumerator, family,
+		country_code, properties.asn, properties.flags);
+}
+
+/*
+	Returns the next network from all runs in the order of their addresses
+*/
+static int loc_database_enumerator_next_run(
+		struct loc_database_enumerator* enumerator, struct loc_database_enumerator_hit* hit) {
+	struct loc_database_enumerator_run* run = NULL;
+	int r;
+
+	for (;;) {
+		// All runs have ended
+		if (!enumerator->runs_count) {
+			hit->network = LOC_DATABASE_NO_NETWORK;
+			return 0;
+		}
+
+		// The run that continues with the lowest address
+		run = &enumerator->runs[0];
+
+		const struct loc_database_network_index_entry_v1* entry = run->next++;
+
+		// Drop the run if it has ended and put the next one on top
+		if (run->next >= run->end)
+			*run = enumerator->runs[--enumerator->runs_count];
+
+		loc_database_enumerator_sift_run(enumerator, 0);
+
+		// The tree has not been validated against the index
+		if (entry->prefix > 128 || be32toh(entry->network) >= enumerator->db->network_objects.count) {
+			ERROR(enumerator->ctx, "Invalid network in network index\n");
+			errno = EBADMSG;
+			return 1;
+		}
+
+		memcpy(&hit->address, entry->address, sizeof(hit->address));
+		hit->prefix  = entry->prefix;
+		hit->network = be32toh(entry->network);
+
+		// The family might still not match
+		r = loc_database_enumerator_match_hit(enumerator, hit);
+		if (r < 0)
+			return 1;
+		else if (r)
+			return 0;
+	}
+}
+
+/*
+	Walks through the network tree until it finds the next network
+*/
+static int loc_database_enumerator_walk_tree(struct loc_database_enumerator* enumerator,
+		struct loc_database_enumerator_hit* hit, int filter) {
+	int r;
+
+	// Return the enclosing networks first
+	while (enumerator->enclosing_next < enumerator->enclosing_count) {
+		*hit = enumerator->enclosing[enumerator->enclosing_next++];
+
+		// Flattening needs them, even if they should not be returned
+		if (!filter)
 			return 0;
 
-		// Throw away anything that doesn't match
-		loc_network_unref(*network);
-		*network = NULL;
+		if (!enumerator->supernets)
+			continue;
+
+		r = loc_database_enumerator_match_hit(enumerator, hit);
+		if (r < 0)
+			return 1;
+		else if (r)
+			return 0;
 	}
 
 	DEBUG(enumerator->ctx, "Called with a stack of %d nodes\n",
 		enumerator->network_stack_depth);
 
+	// Allocate a bitmap of all visited nodes if we cannot trust the tree
+	if (!enumerator->db->validated && !enumerator->networks_visited
+			&& enumerator->network_stack_depth > 0) {
+		enumerator->networks_visited = calloc(
+			(enumerator->db->network_node_objects.count + 63) / 64,
+			sizeof(*enumerator->networks_visited));
+		if (!enumerator->networks_visited) {
+			ERROR(enumerator->ctx, "Could not allocate visited networks: %m\n");
+			return 1;
+		}
+	}
+
 	// Perform DFS
 	while (enumerator->network_stack_depth > 0) {
 		DEBUG(enumerator->ctx, "Stack depth: %d\n", enumerator->network_stack_depth);
 
-		// Get object from top of the stack
-		struct loc_node_stack* node = &enumerator->network_stack[enumerator->network_stack_depth];
+		// Pop node from top of the stack
+		const struct loc_node_stack node =
+			enumerator->network_stack[enumerator->network_stack_depth--];
+
+		DEBUG(enumerator->ctx, "  Got node: %jd\n", (intmax_t)node.offset);
+
+		/*
+			In a validated database, every node can only be reached once. Otherwise
+			we have to remember where we have been so that we won't run in circles.
+		*/
+		if (enumerator->networks_visited) {
+			uint64_t* word = &enumerator->networks_visited[node.offset / 64];
+			const uint64_t bit = 1ull << (node.offset % 64);
 
-		DEBUG(enumerator->ctx, "  Got node: %jd\n", node->offset);
+			if (*word & bit)
+				continue;
 
-		// Remove the node from the stack if we have already visited it
-		if (enumerator->networks_visited[node->offset]) {
-			enumerator->network_stack_depth--;
-			continue;
+			*word |= bit;
 		}
 
 		// Mark the bits on the path correctly
 		loc_address_set_bit(&enumerator->network_address,
-			(node->depth > 0) ? node->depth - 1 : 0, node->i);
+			(node.depth > 0) ? node.depth - 1 : 0, node.i);
 
-		DEBUG(enumerator->ctx, "Looking at node %jd\n", (intmax_t)node->offset);
-		enumerator->networks_visited[node->offset]++;
+		int inside = node.inside;
 
-		// Pop node from top of the stack
-		struct loc_database_network_node_v1* n =
-			(struct loc_database_network_node_v1*)loc_database_object(enumerator->db,
-				&enumerator->db->network_node_objects, sizeof(*n), node->offset);
-		if (!n)
-			return 1;
+		// Skip any subtrees that are entirely outside of the range
+		if (enumerator->range && !inside && !loc_database_enumerator_range_overlaps(
+				enumerator, &enumerator->network_address, node.depth, &inside))
+			continue;
+
+		DEBUG(enumerator->ctx, "Looking at node %jd\n", (intmax_t)node.offset);
+
+		struct loc_database_node n;
+
+		r = loc_database_read_node(enumerator->db, node.offset, &n,
+			loc_database_access(enumerator->db));
+		if (r)
+			return r;
 
 		// Add edges to stack
-		int r = loc_database_enumerator_stack_push_node(enumerator,
-			be32toh(n->one), 1, node->depth + 1);
+		r = loc_database_enumerator_stack_push_node(enumerator,
+			n.children[1], 1, node.depth + 1, inside);
 		if (r)
 			return r;
 
 		r = loc_database_enumerator_stack_push_node(enumerator,
-			be32toh(n->zero), 0, node->depth + 1);
+			n.children[0], 0, node.depth + 1, inside);
 		if (r)
 			return r;
 
-		// Check if this node is a leaf and has a network object
-		if (__loc_database_node_is_leaf(n)) {
-			off_t network_index = be32toh(n->network);
+		// Skip any nodes that don't have a network
+		if (n.network == LOC_DATABASE_NO_NETWORK)
+			continue;
 
-			DEBUG(enumerator->ctx, "Node has a network at %jd\n", (intmax_t)network_index);
+		DEBUG(enumerator->ctx, "Node has a network at %jd\n", (intmax_t)n.network);
 
-			// Fetch the network object
-			r = loc_database_fetch_network(enumerator->db, network,
-				&enumerator->network_address, node->depth, network_index);
+		/*
+			Networks that start before the range belong to another range. When
+			flattening, we still need them because they might cover parts of the range.
+		*/
+		if (enumerator->range && !inside && !enumerator->flatten
+				&& !loc_database_enumerator_range_contains(enumerator,
+					&enumerator->network_address, node.depth))
+			continue;
 
-			// Break on any errors
-			if (r)
-				return r;
+		hit->address = enumerator->network_address;
+		hit->prefix  = node.depth;
+		hit->network = n.network;
 
-			// Return all networks when the filter is disabled, or check for match
-			if (!filter || loc_database_enumerator_match_network(enumerator, *network))
-				return 0;
+		// Return everything if filter isn't enabled, or only return matches
+		if (!filter)
+			return 0;
 
-			// Does not seem to be a match, so we cleanup and move on
-			loc_network_unref(*network);
-			*network = NULL;
-		}
+		r = loc_database_enumerator_match_hit(enumerator, hit);
+		if (r < 0)
+			return 1;
+		else if (r)
+			return 0;
 	}
 
 	// Reached the end of the search
+	hit->network = LOC_DATABASE_NO_NETWORK;
+
 	return 0;
 }
 
-static int __loc_database_enumerator_next_network_flattened(
+static int __loc_database_enumerator_next_network(
 		struct loc_database_enumerator* enumerator, struct loc_network** network) {
-	// Fetch the next network
-	int r = __loc_database_enumerator_next_network(enumerator, network, 1);
+	struct loc_database_enumerator_hit hit;
+	int r;
+
+	*network = NULL;
+
+	// Walk through the tree
+	r = loc_database_enumerator_walk_tree(enumerator, &hit, 1);
 	if (r)
 		return r;
 
-	// End if we could not read another network
-	if (!*network)
+	// Reached the end of the search
+	if (hit.network == LOC_DATABASE_NO_NETWORK)
 		return 0;
 
-	struct loc_network* subnet = NULL;
+	// Fetch the network object
+	return loc_database_fetch_network(enumerator->db, network,
+		&hit.address, hit.prefix, hit.network);
+}
 
-	// Create a list with all subnets
-	if (!enumerator->subnets) {
-		r = loc_network_list_new(enumerator->ctx, &enumerator->subnets);
-		if (r)
-			return r;
+/*
+	Starts a new gap from first to last that belongs to the given network
+	(cut at the edges of the range)
+*/
+static void loc_database_enumerator_flat_gap(struct loc_database_enumerator* enumerator,
+		const struct loc_database_enumerator_flat* flat, const struct in6_addr* last_address) {
+	const struct in6_addr* first_address = &flat->next_address;
+
+	// Don't return anything for networks that don't match
+	if (flat->exhausted || !flat->matches)
+		return;
+
+	if (enumerator->range) {
+		if (loc_address_cmp(first_address, &enumerator->range_first) < 0)
+			first_address = &enumerator->range_first;
+
+		if (loc_address_cmp(last_address, &enumerator->range_last) > 0)
+			last_address = &enumerator->range_last;
 	}
 
-	// Search all subnets from the database
-	while (1) {
-		// Fetch the next network in line
-		r = __loc_database_enumerator_next_network(enumerator, &subnet, 0);
-		if (r) {
-			loc_network_unref(subnet);
-			loc_network_list_clear(enumerator->subnets);
+	// Is the gap empty?
+	if (loc_address_cmp(first_address, last_address) > 0)
+		return;
 
-			return r;
-		}
+	enumerator->gap_first   = *first_address;
+	enumerator->gap_last    = *last_address;
+	enumerator->gap_network = flat->network;
+	enumerator->gap = 1;
+}
 
-		// End if we did not receive another subnet
-		if (!subnet)
-			break;
+/*
+	Returns the largest network from the current gap and moves on
+*/
+static void loc_database_enumerator_flat_next_gap(
+		struct loc_database_enumerator* enumerator, struct loc_database_enumerator_hit* hit) {
+	const struct in6_addr* first_address = &enumerator->gap_first;
+	struct in6_addr last_address;
 
-		// Collect all subnets in a list
-		if (loc_network_is_subnet(*network, subnet)) {
-			r = loc_network_list_push(enumerator->subnets, subnet);
-			if (r) {
-				loc_network_unref(subnet);
-				loc_network_list_clear(enumerator->subnets);
+	const unsigned int prefix = loc_address_largest_block(first_address,
+		&enumerator->gap_last, &last_address);
+
+	hit->address = *first_address;
+	hit->prefix  = prefix;
+	hit->network = enumerator->gap_network;
+
+	// Has the gap been filled?
+	if (loc_address_cmp(&last_address, &enumerator->gap_last) == 0) {
+		enumerator->gap = 0;
+	} else {
+		enumerator->gap_first = last_address;
+		loc_address_increment(&enumerator->gap_first);
+	}
+}
+
+/*
+	Returns the networks from the tree without any overlaps
 
+	All networks that enclose the current position in the tree are kept on a stack.
+	Whenever a subnet starts or an enclosing network ends, the space in between is
+	returned in as few networks as possible with the properties of the enclosing network.
+*/
+static int loc_database_enumerator_next_flat(
+		struct loc_database_enumerator* enumerator, struct loc_database_enumerator_hit* hit) {
+	struct loc_database_enumerator_flat* flat = NULL;
+	struct loc_database_enumerator_hit* next = &enumerator->flat_next;
+	int r;
+
+	for (;;) {
+		// Return anything that is left from the last gap
+		if (enumerator->gap) {
+			loc_database_enumerator_flat_next_gap(enumerator, hit);
+			return 0;
+		}
+
+		// Fetch the next network from the tree
+		if (!enumerator->flat_next_ready) {
+			r = loc_database_enumerator_walk_tree(enumerator, next, 0);
+			if (r)
 				return r;
-			}
 
-			loc_network_unref(subnet);
-			continue;
+			enumerator->flat_next_ready = 1;
 		}
 
-		// If this is not a subnet, we push it back onto the stack and break
-		r = loc_network_list_push(enumerator->stack, subnet);
-		if (r) {
-			loc_network_unref(subnet);
-			loc_network_list_clear(enumerator->subnets);
+		const int end = (next->network == LOC_DATABASE_NO_NETWORK);
 
-			return r;
+		if (!end && next->prefix > 128) {
+			ERROR(enumerator->ctx, "Invalid prefix /%u\n", next->prefix);
+			errno = EBADMSG;
+			return 1;
 		}
 
-		loc_network_unref(subnet);
-		break;
-	}
+		const struct in6_addr bitmask = loc_prefix_to_bitmask(next->prefix);
+		const struct in6_addr first_address = loc_address_and(&next->address, &bitmask);
 
-	DEBUG(enumerator->ctx, "Found %zu subnet(s)\n",
-		loc_network_list_size(enumerator->subnets));
+		if (enumerator->flat_depth) {
+			flat = &enumerator->flat_stack[enumerator->flat_depth - 1];
 
-	// We can abort here if the network has no subnets
-	if (loc_network_list_empty(enumerator->subnets)) {
-		loc_network_list_clear(enumerator->subnets);
+			// If the next network is not a subnet, the enclosing network ends here
+			if (end || loc_address_cmp(&first_address, &flat->last_address) > 0) {
+				loc_database_enumerator_flat_gap(enumerator, flat, &flat->last_address);
 
-		return 0;
-	}
+				enumerator->flat_depth--;
+				continue;
+			}
 
-	// If the network has any subnets, we will break it into smaller parts
-	// without the subnets.
-	struct loc_network_list* excluded = loc_network_exclude_list(*network, enumerator->subnets);
-	if (!excluded) {
-		loc_network_list_clear(enumerator->subnets);
-		return 1;
-	}
+			// Otherwise return everything up to the start of the subnet
+			if (loc_address_cmp(&flat->next_address, &first_address) < 0) {
+				struct in6_addr last_address = first_address;
+				loc_address_decrement(&last_address);
 
-	// Merge subnets onto the stack
-	r = loc_network_list_merge(enumerator->stack, enumerator->subnets);
-	if (r) {
-		loc_network_list_clear(enumerator->subnets);
-		loc_network_list_unref(excluded);
+				loc_database_enumerator_flat_gap(enumerator, flat, &last_address);
+			}
 
-		return r;
-	}
+			// Everything else in this subnet will be handled by the subnet
+			const struct in6_addr last_address = loc_address_or(&first_address, &bitmask);
 
-	// Push excluded list onto the stack
-	r = loc_network_list_merge(enumerator->stack, excluded);
-	if (r) {
-		loc_network_list_clear(enumerator->subnets);
-		loc_network_list_unref(excluded);
+			if (loc_address_cmp(&last_address, &flat->last_address) == 0) {
+				flat->exhausted = 1;
+			} else {
+				flat->next_address = last_address;
+				loc_address_increment(&flat->next_address);
+			}
+		}
 
-		return r;
-	}
+		// We are done when the tree and the stack are empty
+		if (end) {
+			hit->network = LOC_DATABASE_NO_NETWORK;
+			return 0;
+		}
+
+		// Networks cannot be nested any deeper than their prefix
+		if (enumerator->flat_depth >= LOC_DATABASE_MAX_NESTING) {
+			ERROR(enumerator->ctx, "Networks are nested too deeply\n");
+			errno = EBADMSG;
+			return 1;
+		}
+
+		flat = &enumerator->flat_stack[enumerator->flat_depth++];
 
-	loc_network_list_clear(enumerator->subnets);
-	loc_network_list_unref(excluded);
+		flat->first_address = first_address;
+		flat->last_address  = loc_address_or(&first_address, &bitmask);
+		flat->next_address  = first_address;
+		flat->exhausted     = 0;
+		flat->network       = next->network;
+
+		// Check whether we want to return any of this network
+		r = loc_database_enumerator_match_hit(enumerator, next);
+		if (r < 0)
+			return 1;
 
-	// Drop the network and restart the whole process again to pick the next network
-	loc_network_unref(*network);
+		flat->matches = r;
 
-	return __loc_database_enumerator_next_network_flattened(enumerator, network);
+		enumerator->flat_next_ready = 0;
+	}
 }
 
 /*
@@ -1549,7 +4206,7 @@ static int __loc_database_enumerator_next_bogon(
 	struct in6_addr gap_end = IN6ADDR_ANY_INIT;
 
 	while (1) {
-		r = __loc_database_enumerator_next_network(enumerator, &network, 1);
+		r = __loc_database_enumerator_next_network(enumerator, &network);
 		if (r)
 			return r;
 
@@ -1664,17 +4321,151 @@ FINISH:
 	return 0;
 }
 
+/*
+	Prepares the enumerator on the first call
+*/
+static int loc_database_enumerator_setup(struct loc_database_enumerator* enumerator) {
+	int r;
+
+	// Compile the filter
+	if (!enumerator->filter_ready) {
+		r = loc_database_enumerator_compile_filter(enumerator);
+		if (r)
+			return r;
+	}
+
+	// Check if we can use an index
+	if (!enumerator->runs_ready) {
+		enumerator->fingerprint = loc_database_enumerator_fingerprint(enumerator);
+
+		// Skip straight to the position of the cursor
+		loc_database_enumerator_seek(enumerator);
+
+		r = loc_database_enumerator_find_runs(enumerator);
+		if (r)
+			return r;
+
+		enumerator->runs_ready = 1;
+	}
+
+	return 0;
+}
+
+/*
+	Returns the next network from the index or the tree without creating an object
+*/
+static int __loc_database_enumerator_next_hit(
+		struct loc_database_enumerator* enumerator, struct loc_database_enumerator_hit* hit) {
+	// Read from the index instead of walking the tree
+	if (enumerator->runs)
+		return loc_database_enumerator_next_run(enumerator, hit);
+
+	// Flatten output?
+	if (enumerator->flatten)
+		return loc_database_enumerator_next_flat(enumerator, hit);
+
+	return loc_database_enumerator_walk_tree(enumerator, hit, 1);
+}
+
+/*
+	Compares a hit with the position of the cursor in the order networks are returned in
+*/
+static int loc_database_enumerator_cmp_cursor(struct loc_database_enumerator* enumerator,
+		const struct loc_database_enumerator_hit* hit) {
+	const struct in6_addr bitmask = loc_prefix_to_bitmask(hit->prefix);
+
+	// The tree does not clear any bits behind the prefix
+	const struct in6_addr address = loc_address_and(&hit->address, &bitmask);
+
+	int r = loc_address_cmp(&address, &enumerator->cursor_address);
+	if (r)
+		return r;
+
+	return (hit->prefix > enumerator->cursor_prefix) - (hit->prefix < enumerator->cursor_prefix);
+}
+
+static int loc_database_enumerator_next_hit(
+		struct loc_database_enumerator* enumerator, struct loc_database_enumerator_hit* hit) {
+	int r;
+
+	switch (enumerator->cursor) {
+		case LOC_DATABASE_CURSOR_START:
+			r = __loc_database_enumerator_next_hit(enumerator, hit);
+			if (r)
+				return r;
+			break;
+
+		// Everything has been returned before
+		case LOC_DATABASE_CURSOR_END:
+			hit->network = LOC_DATABASE_NO_NETWORK;
+			break;
+
+		/*
+			Networks are returned in the order of their first address and prefix.
+			The range starts at the address of the cursor, so we only have to skip
+			the few networks that have been returned before and start there, too.
+		*/
+		case LOC_DATABASE_CURSOR_AFTER:
+			for (;;) {
+				r = __loc_database_enumerator_next_hit(enumerator, hit);
+				if (r)
+					return r;
+
+				if (hit->network == LOC_DATABASE_NO_NETWORK)
+					break;
+
+				r = loc_database_enumerator_cmp_cursor(enumerator, hit);
+				if (r > 0)
+					break;
+			}
+
+			enumerator->cursor = LOC_DATABASE_CURSOR_START;
+			break;
+	}
+
+	// Remember the position for the next cursor
+	if (hit->network == LOC_DATABASE_NO_NETWORK) {
+		enumerator->position = LOC_DATABASE_CURSOR_END;
+	} else {
+		const struct in6_addr bitmask = loc_prefix_to_bitmask(hit->prefix);
+
+		enumerator->position         = LOC_DATABASE_CURSOR_AFTER;
+		enumerator->position_address = loc_address_and(&hit->address, &bitmask);
+		enumerator->position_prefix  = hit->prefix;
+	}
+
+	return 0;
+}
+
 LOC_EXPORT int loc_database_enumerator_next_network(
 		struct loc_database_enumerator* enumerator, struct loc_network** network) {
+	struct loc_database_enumerator_hit hit;
+	int r;
+
+	*network = NULL;
+
 	switch (enumerator->mode) {
 		case LOC_DB_ENUMERATE_NETWORKS:
-			// Flatten output?
-			if (enumerator->flatten)
-				return __loc_database_enumerator_next_network_flattened(enumerator, network);
+			r = loc_database_enumerator_setup(enumerator);
+			if (r)
+				return r;
+
+			r = loc_database_enumerator_next_hit(enumerator, &hit);
+			if (r)
+				return r;
+
+			// Reached the end
+			if (hit.network == LOC_DATABASE_NO_NETWORK)
+				return 0;
 
-			return __loc_database_enumerator_next_network(enumerator, network, 1);
+			return loc_database_fetch_network(enumerator->db, network,
+				&hit.address, hit.prefix, hit.network);
 
 		case LOC_DB_ENUMERATE_BOGONS:
+			r = loc_database_enumerator_setup(enumerator);
+			if (r)
+				return r;
+
 			return __loc_database_enumerator_next_bogon(enumerator, network);
 
 		default:
@@ -1682,6 +4473,168 @@ LOC_EXPORT int loc_database_enumerator_next_network(
 	}
 }
 
+/*
+	Copies the next network into info. The family is AF_UNSPEC if there are no more networks.
+*/
+static int __loc_database_enumerator_next_info(
+		struct loc_database_enumerator* enumerator, struct loc_network_info* info) {
+	struct loc_database_enumerator_hit hit;
+	struct loc_network* network = NULL;
+	int r;
+
+	info->family = AF_UNSPEC;
+
+	switch (enumerator->mode) {
+		case LOC_DB_ENUMERATE_NETWORKS:
+			r = loc_database_enumerator_setup(enumerator);
+			if (r)
+				return r;
+
+			r = loc_database_enumerator_next_hit(enumerator, &hit);
+			if (r)
+				return r;
+
+			// Reached the end
+			if (hit.network == LOC_DATABASE_NO_NETWORK)
+				return 0;
+
+			return loc_database_fetch_network_info(enumerator->db, info,
+				&hit.address, hit.prefix, hit.network);
+
+		case LOC_DB_ENUMERATE_BOGONS:
+			break;
+
+		default:
+			return 0;
+	}
+
+	// Fall back to fetching the next network object
+	r = loc_database_enumerator_next_network(enumerator, &network);
+	if (r)
+		return r;
+
+	if (network) {
+		loc_network_to_info(network, info);
+		loc_network_unref(network);
+	}
+
+	return 0;
+}
+
+LOC_EXPORT int loc_database_enumerator_next_networks(struct loc_database_enumerator* enumerator,
+		struct loc_network_info* networks, size_t size, size_t* count) {
+	int r;
+
+	*count = 0;
+
+	while (*count < size) {
+		r = __loc_database_enumerator_next_info(enumerator, &networks[*count]);
+		if (r)
+			return r;
+
+		// Reached the end
+		if (networks[*count].family == AF_UNSPEC)
+			break;
+
+		(*count)++;
+	}
+
+	return 0;
+}
+
+LOC_EXPORT int loc_database_enumerator_walk(struct loc_database_enumerator* enumerator,
+		loc_database_enumerator_callback callback, void* data) {
+	struct loc_network_info info;
+	int r;
+
+	for (;;) {
+		r = __loc_database_enumerator_next_info(enumerator, &info);
+		if (r)
+			return r;
+
+		// Reached the end
+		if (info.family == AF_UNSPEC)
+			return 0;
+
+		// Stop if the callback asks us to
+		r = callback(&info, data);
+		if (r)
+			return r;
+	}
+}
+
+/*
+	Splits the address space into ranges that hold about the same number of networks
+
+	All networks are visited in the order of their first address and a new range
+	starts after every (total / count) networks.
+*/
+LOC_EXPORT int loc_database_partition(struct loc_database* db,
+		struct loc_database_range* ranges, size_t* count) {
+	struct loc_database_enumerator* enumerator = NULL;
+	struct loc_database_enumerator_hit hit;
+	struct in6_addr first_address;
+	size_t partitions = 0;
+	size_t networks = 0;
+	int r;
+
+	if (!*count) {
+		errno = EINVAL;
+		return 1;
+	}
+
+	r = loc_database_enumerator_new(&enumerator, db, LOC_DB_ENUMERATE_NETWORKS, 0);
+	if (r)
+		return r;
+
+	// The first range starts at the beginning of the address space
+	memset(&ranges[0].first_address, 0, sizeof(ranges[0].first_address));
+	partitions = 1;
+
+	// Networks are only counted, so we know how many there are in total
+	const size_t total = db->network_objects.count;
+
+	while (partitions < *count) {
+		r = loc_database_enumerator_walk_tree(enumerator, &hit, 0);
+		if (r)
+			goto ERROR;
+
+		// Reached the end
+		if (hit.network == LOC_DATABASE_NO_NETWORK)
+			break;
+
+		// Start a new range once this one has enough networks
+		if (networks++ < partitions * total / *count)
+			continue;
+
+		const struct in6_addr bitmask = loc_prefix_to_bitmask(hit.prefix);
+		first_address = loc_address_and(&hit.address, &bitmask);
+
+		// Networks with the same first address must be in the same range
+		if (!loc_address_cmp(&first_address, &ranges[partitions - 1].first_address))
+			continue;
+
+		// The previous range ends right before
+		ranges[partitions - 1].last_address = first_address;
+		loc_address_decrement(&ranges[partitions - 1].last_address);
+
+		ranges[partitions++].first_address = first_address;
+	}
+
+	// The last range ends at the end of the address space
+	memset(&ranges[partitions - 1].last_address, 0xff,
+		sizeof(ranges[partitions - 1].last_address));
+
+	DEBUG(db->ctx, "Split the database into %zu range(s)\n", partitions);
+
+	*count = partitions;
+
+ERROR:
+	loc_database_enumerator_unref(enumerator);
+
+	return r;
+}
+
 LOC_EXPORT int loc_database_enumerator_next_country(
 		struct loc_database_enumerator* enumerator, struct loc_country** country) {
 	*country = NULL;
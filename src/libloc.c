@@ -16,6 +16,7 @@
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
@@ -29,7 +30,7 @@
 #include <libloc/private.h>
 
 struct loc_ctx {
-	int refcount;
+	atomic_int refcount;
 
 	// Logging
 	struct loc_ctx_logging {
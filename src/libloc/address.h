@@ -319,6 +319,37 @@ static inline void loc_address_decrement(struct in6_addr* address) {
 	}
 }
 
+/*
+	Returns the prefix of the largest network that starts at the first address
+	and does not reach beyond the last address, and stores where it ends
+*/
+static inline unsigned int loc_address_largest_block(const struct in6_addr* first_address,
+		const struct in6_addr* last_address, struct in6_addr* block_last_address) {
+	struct in6_addr bitmask;
+	unsigned int prefix = 0;
+
+	// Start with the largest network that can start at the first address
+	for (int i = 3; i >= 0; i--) {
+		const uint32_t word = be32toh(first_address->s6_addr32[i]);
+
+		if (word) {
+			prefix = 32 * (i + 1) - __builtin_ctz(word);
+			break;
+		}
+	}
+
+	// Make it smaller until it does not go beyond the last address
+	for (;; prefix++) {
+		bitmask = loc_prefix_to_bitmask(prefix);
+		*block_last_address = loc_address_or(first_address, &bitmask);
+
+		if (loc_address_cmp(block_last_address, last_address) <= 0)
+			break;
+	}
+
+	return prefix;
+}
+
 static inline int loc_address_get_octet(const struct in6_addr* address, const unsigned int i) {
 	if (IN6_IS_ADDR_V4MAPPED(address)) {
 		if (i >= 4)
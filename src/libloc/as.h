@@ -37,6 +37,8 @@ int loc_as_cmp(struct loc_as* as1, struct loc_as* as2);
 
 #ifdef LIBLOC_PRIVATE
 
+void loc_as_set_readonly(struct loc_as* as);
+
 int loc_as_new_from_database_v1(struct loc_ctx* ctx, struct loc_stringpool* pool,
 		struct loc_as** as, const struct loc_database_as_v1* dbobj);
 int loc_as_to_database_v1(struct loc_as* as, struct loc_stringpool* pool,
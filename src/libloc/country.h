@@ -43,6 +43,8 @@ int loc_country_special_code_to_flag(const char* cc);
 
 #include <string.h>
 
+void loc_country_set_readonly(struct loc_country* country);
+
 int loc_country_new_from_database_v1(struct loc_ctx* ctx, struct loc_stringpool* pool,
 		struct loc_country** country, const struct loc_database_country_v1* dbobj);
 int loc_country_to_database_v1(struct loc_country* country,
@@ -39,17 +39,45 @@ const char* loc_database_get_vendor(struct loc_database* db);
 const char* loc_database_get_description(struct loc_database* db);
 const char* loc_database_get_license(struct loc_database* db);
 
+enum loc_database_index_flags {
+	LOC_DB_INDEX_STRIDE   = (1 << 0),
+	LOC_DB_INDEX_DIR24    = (1 << 1),
+	LOC_DB_INDEX_AS_NAMES = (1 << 2),
+};
+
+int loc_database_build_index(struct loc_database* db, int flags);
+int loc_database_validate(struct loc_database* db);
+
 int loc_database_get_as(struct loc_database* db, struct loc_as** as, uint32_t number);
+int loc_database_get_as_name(struct loc_database* db, uint32_t number, const char** name);
 size_t loc_database_count_as(struct loc_database* db);
 
 int loc_database_lookup(struct loc_database* db,
 		const struct in6_addr* address, struct loc_network** network);
 int loc_database_lookup_from_string(struct loc_database* db,
 		const char* string, struct loc_network** network);
+int loc_database_lookup_info(struct loc_database* db,
+		const struct in6_addr* address, struct loc_network_info* info);
+int loc_database_lookup4(struct loc_database* db,
+		uint32_t address, struct loc_network_info* info);
+int loc_database_lookup_many(struct loc_database* db,
+		const struct in6_addr* addresses, size_t count, struct loc_network_info* results);
 
 int loc_database_get_country(struct loc_database* db,
 		struct loc_country** country, const char* code);
 
+struct loc_database_cache;
+int loc_database_cache_new(struct loc_database_cache** cache,
+	struct loc_database* db, size_t size, unsigned int prefix4, unsigned int prefix6);
+struct loc_database_cache* loc_database_cache_ref(struct loc_database_cache* cache);
+struct loc_database_cache* loc_database_cache_unref(struct loc_database_cache* cache);
+
+int loc_database_cache_lookup(struct loc_database_cache* cache,
+	const struct in6_addr* address, struct loc_network** network);
+
+uint64_t loc_database_cache_hits(struct loc_database_cache* cache);
+uint64_t loc_database_cache_misses(struct loc_database_cache* cache);
+
 enum loc_database_enumerator_mode {
 	LOC_DB_ENUMERATE_NETWORKS  = 1,
 	LOC_DB_ENUMERATE_ASES      = 2,
@@ -58,7 +86,8 @@ enum loc_database_enumerator_mode {
 };
 
 enum loc_database_enumerator_flags {
-	LOC_DB_ENUMERATOR_FLAGS_FLATTEN = (1 << 0),
+	LOC_DB_ENUMERATOR_FLAGS_FLATTEN   = (1 << 0),
+	LOC_DB_ENUMERATOR_FLAGS_SUPERNETS = (1 << 1),
 };
 
 struct loc_database_enumerator;
@@ -77,6 +106,19 @@ int loc_database_enumerator_set_asns(
 	struct loc_database_enumerator* enumerator, struct loc_as_list* asns);
 int loc_database_enumerator_set_flag(struct loc_database_enumerator* enumerator, enum loc_network_flags flag);
 int loc_database_enumerator_set_family(struct loc_database_enumerator* enumerator, int family);
+int loc_database_enumerator_set_network(
+	struct loc_database_enumerator* enumerator, struct loc_network* network);
+int loc_database_enumerator_set_range(struct loc_database_enumerator* enumerator,
+	const struct in6_addr* first_address, const struct in6_addr* last_address);
+
+// The size of a cursor including the terminating NUL byte
+#define LOC_DATABASE_CURSOR_LENGTH 47
+
+int loc_database_enumerator_get_cursor(struct loc_database_enumerator* enumerator,
+	char* cursor, size_t length);
+int loc_database_enumerator_set_cursor(struct loc_database_enumerator* enumerator,
+	const char* cursor);
+
 int loc_database_enumerator_next_as(
 	struct loc_database_enumerator* enumerator, struct loc_as** as);
 int loc_database_enumerator_next_network(
@@ -84,4 +126,19 @@ int loc_database_enumerator_next_network(
 int loc_database_enumerator_next_country(
 	struct loc_database_enumerator* enumerator, struct loc_country** country);
 
+int loc_database_enumerator_next_networks(struct loc_database_enumerator* enumerator,
+	struct loc_network_info* networks, size_t size, size_t* count);
+
+struct loc_database_range {
+	struct in6_addr first_address;
+	struct in6_addr last_address;
+};
+
+int loc_database_partition(struct loc_database* db,
+	struct loc_database_range* ranges, size_t* count);
+
+typedef int (*loc_database_enumerator_callback)(const struct loc_network_info* network, void* data);
+int loc_database_enumerator_walk(struct loc_database_enumerator* enumerator,
+	loc_database_enumerator_callback callback, void* data);
+
 #endif
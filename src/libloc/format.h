@@ -82,8 +82,16 @@ struct loc_database_header_v1 {
 	char signature1[LOC_SIGNATURE_MAX_LENGTH];
 	char signature2[LOC_SIGNATURE_MAX_LENGTH];
 
+	// Tells us where the networks of each AS start (zero if there are none)
+	uint32_t as_networks_offset;
+	uint32_t as_networks_length;
+
+	// Tells us where the networks of each country start (zero if there are none)
+	uint32_t country_networks_offset;
+	uint32_t country_networks_length;
+
 	// Add some padding for future extensions
-	char padding[32];
+	char padding[16];
 };
 
 struct loc_database_network_node_v1 {
@@ -109,6 +117,49 @@ struct loc_database_network_v1 {
 	char padding[2];
 };
 
+// Networks can be nested once for each prefix length
+#define LOC_DATABASE_MAX_NESTING 129
+
+/*
+	A network index lists the networks of each key (e.g. an ASN) in the order
+	of their addresses. It starts with this header, which is followed by all
+	keys in ascending order and then by all networks.
+
+	The networks of each country are flattened, i.e. they only cover the parts
+	of each network that are not covered by any subnet.
+*/
+struct loc_database_network_index_v1 {
+	// The number of keys
+	uint32_t keys;
+
+	// The number of networks
+	uint32_t networks;
+};
+
+// Country codes are stored as keys like this
+#define LOC_DATABASE_COUNTRY_KEY(cc) \
+	(((uint32_t)(unsigned char)(cc)[0] << 8) | (uint32_t)(unsigned char)(cc)[1])
+
+struct loc_database_network_index_key_v1 {
+	uint32_t key;
+
+	// Where the networks of this key start and how many there are
+	uint32_t first;
+	uint32_t count;
+};
+
+struct loc_database_network_index_entry_v1 {
+	// The start address and the prefix as they are encoded in the tree
+	uint8_t address[16];
+	uint8_t prefix;
+
+	// Reserved
+	char padding[3];
+
+	// The index of the network
+	uint32_t network;
+};
+
 struct loc_database_as_v1 {
 	// The AS number
 	uint32_t number;
@@ -30,6 +30,21 @@ enum loc_network_flags {
 	LOC_NETWORK_FLAG_DROP               = (1 << 3), // XD
 };
 
+/*
+	A plain copy of the properties of a network which can be
+	filled in without allocating any memory
+*/
+struct loc_network_info {
+	int family;
+	struct in6_addr first_address;
+	struct in6_addr last_address;
+	unsigned int prefix;
+
+	char country_code[3];
+	uint32_t asn;
+	enum loc_network_flags flags;
+};
+
 struct loc_network;
 int loc_network_new(struct loc_ctx* ctx, struct loc_network** network,
 		struct in6_addr* first_address, unsigned int prefix);
@@ -70,12 +85,18 @@ char* loc_network_reverse_pointer(struct loc_network* network, const char* suffi
 
 #ifdef LIBLOC_PRIVATE
 
+void loc_network_set_readonly(struct loc_network* network);
+
 int loc_network_properties_cmp(struct loc_network* self, struct loc_network* other);
 unsigned int loc_network_raw_prefix(struct loc_network* network);
 
 int loc_network_to_database_v1(struct loc_network* network, struct loc_database_network_v1* dbobj);
 int loc_network_new_from_database_v1(struct loc_ctx* ctx, struct loc_network** network,
 		struct in6_addr* address, unsigned int prefix, const struct loc_database_network_v1* dbobj);
+int loc_network_info_from_database_v1(struct loc_network_info* info,
+		const struct in6_addr* address, unsigned int prefix, const struct loc_database_network_v1* dbobj);
+
+void loc_network_to_info(struct loc_network* network, struct loc_network_info* info);
 
 int loc_network_merge(struct loc_network** n, struct loc_network* n1, struct loc_network* n2);
 
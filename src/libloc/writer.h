@@ -27,6 +27,14 @@
 
 struct loc_writer;
 
+enum loc_writer_flags {
+	// Write an index of the networks of each AS
+	LOC_WRITER_INDEX_AS_NETWORKS      = (1 << 0),
+
+	// Write an index of the flattened networks of each country
+	LOC_WRITER_INDEX_COUNTRY_NETWORKS = (1 << 1),
+};
+
 int loc_writer_new(struct loc_ctx* ctx, struct loc_writer** writer,
     FILE* fkey1, FILE* fkey2);
 
@@ -40,6 +48,8 @@ int loc_writer_set_description(struct loc_writer* writer, const char* descriptio
 const char* loc_writer_get_license(struct loc_writer* writer);
 int loc_writer_set_license(struct loc_writer* writer, const char* license);
 
+int loc_writer_set_flags(struct loc_writer* writer, int flags);
+
 int loc_writer_add_as(struct loc_writer* writer, struct loc_as** as, uint32_t number);
 int loc_writer_add_network(struct loc_writer* writer, struct loc_network** network, const char* string);
 int loc_writer_add_country(struct loc_writer* writer, struct loc_country** country, const char* country_code);
@@ -15,6 +15,7 @@
 */
 
 #include <errno.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <time.h>
 
@@ -25,7 +26,7 @@
 
 struct loc_network_list {
 	struct loc_ctx* ctx;
-	int refcount;
+	atomic_int refcount;
 
 	struct loc_network** elements;
 	size_t elements_size;
@@ -14,6 +14,7 @@
 	Lesser General Public License for more details.
 */
 
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <errno.h>
@@ -25,14 +26,14 @@
 
 struct loc_network_tree {
 	struct loc_ctx* ctx;
-	int refcount;
+	atomic_int refcount;
 
 	struct loc_network_tree_node* root;
 };
 
 struct loc_network_tree_node {
 	struct loc_ctx* ctx;
-	int refcount;
+	atomic_int refcount;
 
 	struct loc_network_tree_node* zero;
 	struct loc_network_tree_node* one;
@@ -17,6 +17,7 @@
 #include <arpa/inet.h>
 #include <assert.h>
 #include <errno.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -35,7 +36,7 @@
 
 struct loc_network {
 	struct loc_ctx* ctx;
-	int refcount;
+	atomic_int refcount;
 
 	int family;
 	struct in6_addr first_address;
@@ -47,6 +48,9 @@ struct loc_network {
 	enum loc_network_flags flags;
 
 	char string[INET6_ADDRSTRLEN + 4];
+
+	// Objects that are shared by a cache cannot be changed
+	int readonly;
 };
 
 LOC_EXPORT int loc_network_new(struct loc_ctx* ctx, struct loc_network** network,
@@ -203,6 +207,11 @@ LOC_EXPORT const char* loc_network_get_country_code(struct loc_network* network)
 }
 
 LOC_EXPORT int loc_network_set_country_code(struct loc_network* network, const char* country_code) {
+	if (network->readonly) {
+		errno = EPERM;
+		return 1;
+	}
+
 	// Set empty country code
 	if (!country_code || !*country_code) {
 		*network->country_code = '\0';
@@ -240,6 +249,11 @@ LOC_EXPORT uint32_t loc_network_get_asn(struct loc_network* network) {
 }
 
 LOC_EXPORT int loc_network_set_asn(struct loc_network* network, uint32_t asn) {
+	if (network->readonly) {
+		errno = EPERM;
+		return 1;
+	}
+
 	network->asn = asn;
 
 	return 0;
@@ -250,11 +264,20 @@ LOC_EXPORT int loc_network_has_flag(struct loc_network* network, uint32_t flag)
 }
 
 LOC_EXPORT int loc_network_set_flag(struct loc_network* network, uint32_t flag) {
+	if (network->readonly) {
+		errno = EPERM;
+		return 1;
+	}
+
 	network->flags |= flag;
 
 	return 0;
 }
 
+void loc_network_set_readonly(struct loc_network* network) {
+	network->readonly = 1;
+}
+
 LOC_EXPORT int loc_network_cmp(struct loc_network* self, struct loc_network* other) {
 	// Compare address
 	int r = loc_address_cmp(&self->first_address, &other->first_address);
@@ -700,6 +723,55 @@ int loc_network_new_from_database_v1(struct loc_ctx* ctx, struct loc_network** n
 	return 0;
 }
 
+int loc_network_info_from_database_v1(struct loc_network_info* info,
+		const struct in6_addr* address, unsigned int prefix, const struct loc_database_network_v1* dbobj) {
+	// Validate the prefix
+	if (!loc_address_valid_prefix(address, IN6_IS_ADDR_V4MAPPED(address) ? prefix - 96 : prefix)) {
+		errno = EINVAL;
+		return 1;
+	}
+
+	// Convert the prefix into a bitmask
+	const struct in6_addr bitmask = loc_prefix_to_bitmask(prefix);
+
+	// Store the first and last address in the network
+	info->first_address = loc_address_and(address, &bitmask);
+	info->last_address  = loc_address_or(&info->first_address, &bitmask);
+
+	// Set family & prefix
+	info->family = loc_address_family(&info->first_address);
+	info->prefix = (info->family == AF_INET) ? prefix - 96 : prefix;
+
+	// Import country code
+	loc_country_code_copy(info->country_code, dbobj->country_code);
+	info->country_code[2] = '\0';
+
+	// Refuse the same country codes that loc_network_set_country_code() refuses
+	if (*info->country_code && !loc_country_code_is_valid(info->country_code)) {
+		errno = EINVAL;
+		return -EINVAL;
+	}
+
+	// Import ASN & flags
+	info->asn   = be32toh(dbobj->asn);
+	info->flags = be16toh(dbobj->flags);
+
+	return 0;
+}
+
+void loc_network_to_info(struct loc_network* network, struct loc_network_info* info) {
+	info->family        = network->family;
+	info->first_address = network->first_address;
+	info->last_address  = network->last_address;
+	info->prefix        = loc_network_prefix(network);
+
+	loc_country_code_copy(info->country_code, network->country_code);
+	info->country_code[2] = '\0';
+
+	info->asn   = network->asn;
+	info->flags = network->flags;
+}
+
 static char* loc_network_reverse_pointer6(struct loc_network* network, const char* suffix) {
 	char* buffer = NULL;
 	int r;
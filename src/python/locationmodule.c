@@ -19,6 +19,7 @@
 
 #include <libloc/format.h>
 #include <libloc/resolv.h>
+#include <libloc/writer.h>
 
 #include "locationmodule.h"
 #include "as.h"
@@ -180,6 +181,13 @@ PyMODINIT_FUNC PyInit__location(void) {
 	if (PyModule_AddIntConstant(m, "NETWORK_FLAG_DROP", LOC_NETWORK_FLAG_DROP))
 		return NULL;
 
+	// Add writer flags
+	if (PyModule_AddIntConstant(m, "WRITER_INDEX_AS_NETWORKS", LOC_WRITER_INDEX_AS_NETWORKS))
+		return NULL;
+
+	if (PyModule_AddIntConstant(m, "WRITER_INDEX_COUNTRY_NETWORKS", LOC_WRITER_INDEX_COUNTRY_NETWORKS))
+		return NULL;
+
 	// Add latest database version
 	if (PyModule_AddIntConstant(m, "DATABASE_VERSION_LATEST", LOC_DATABASE_VERSION_LATEST))
 		return NULL;
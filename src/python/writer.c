@@ -145,6 +145,21 @@ static int Writer_set_license(WriterObject* self, PyObject* value) {
 	return 0;
 }
 
+static PyObject* Writer_set_flags(WriterObject* self, PyObject* args) {
+	int flags = 0;
+
+	if (!PyArg_ParseTuple(args, "i", &flags))
+		return NULL;
+
+	int r = loc_writer_set_flags(self->writer, flags);
+	if (r) {
+		PyErr_Format(PyExc_ValueError, "Could not set flags: %d", flags);
+		return NULL;
+	}
+
+	Py_RETURN_NONE;
+}
+
 static PyObject* Writer_add_as(WriterObject* self, PyObject* args) {
 	struct loc_as* as;
 	uint32_t number = 0;
@@ -262,6 +277,12 @@ static struct PyMethodDef Writer_methods[] = {
 		METH_VARARGS,
 		NULL,
 	},
+	{
+		"set_flags",
+		(PyCFunction)Writer_set_flags,
+		METH_VARARGS,
+		NULL,
+	},
 	{
 		"write",
 		(PyCFunction)Writer_write,
@@ -15,6 +15,7 @@
 */
 
 #include <errno.h>
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,7 +32,7 @@
 
 struct loc_stringpool {
 	struct loc_ctx* ctx;
-	int refcount;
+	atomic_int refcount;
 
 	// Reference to any mapped data
 	const char* data;
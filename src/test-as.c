@@ -20,11 +20,144 @@
 #include <syslog.h>
 
 #include <libloc/libloc.h>
+#include <libloc/as.h>
+#include <libloc/as-list.h>
 #include <libloc/database.h>
 #include <libloc/writer.h>
 
 #define TEST_AS_COUNT 5000
 
+/*
+	Searches for string and compares the result with all names that contain it
+*/
+static int check_search(struct loc_database* db, const char* string) {
+	struct loc_database_enumerator* enumerator = NULL;
+	struct loc_as* as = NULL;
+	unsigned int expected = 1;
+	char name[256];
+	int r;
+
+	r = loc_database_enumerator_new(&enumerator, db, LOC_DB_ENUMERATE_ASES, 0);
+	if (r) {
+		fprintf(stderr, "Could not create a database enumerator\n");
+		return r;
+	}
+
+	r = loc_database_enumerator_set_string(enumerator, string);
+	if (r)
+		goto ERROR;
+
+	for (;;) {
+		r = loc_database_enumerator_next_as(enumerator, &as);
+		if (r) {
+			fprintf(stderr, "Could not enumerate next AS\n");
+			goto ERROR;
+		}
+
+		// Find the next AS that should match
+		for (; expected <= TEST_AS_COUNT; expected++) {
+			sprintf(name, "Test AS%u", expected);
+
+			if (strcasestr(name, string))
+				break;
+		}
+
+		if (!as)
+			break;
+
+		if (loc_as_get_number(as) != expected) {
+			fprintf(stderr, "Searching for '%s' found AS%u instead of AS%u\n",
+				string, loc_as_get_number(as), expected);
+			r = 1;
+		}
+
+		loc_as_unref(as);
+		if (r)
+			goto ERROR;
+
+		expected++;
+	}
+
+	if (expected <= TEST_AS_COUNT) {
+		fprintf(stderr, "Searching for '%s' did not find AS%u\n", string, expected);
+		r = 1;
+	}
+
+ERROR:
+	loc_database_enumerator_unref(enumerator);
+
+	return r;
+}
+
+static int check_list(struct loc_ctx* ctx) {
+	struct loc_as_list* list = NULL;
+	struct loc_as* as = NULL;
+	int r;
+
+	r = loc_as_list_new(ctx, &list);
+	if (r)
+		return r;
+
+	// Add many ASes including the smallest and largest number, and every one twice
+	for (unsigned int i = 0; i < 2; i++) {
+		for (uint32_t number = 0; number < 100000; number += 2) {
+			r = loc_as_new(ctx, &as, (number) ? number : 0xffffffff);
+			if (r)
+				goto ERROR;
+
+			r = loc_as_list_append(list, as);
+			loc_as_unref(as);
+			if (r)
+				goto ERROR;
+		}
+
+		r = loc_as_new(ctx, &as, 0);
+		if (r)
+			goto ERROR;
+
+		r = loc_as_list_append(list, as);
+		loc_as_unref(as);
+		if (r)
+			goto ERROR;
+	}
+
+	if (loc_as_list_size(list) != 50001) {
+		fprintf(stderr, "The AS list has %zu elements\n", loc_as_list_size(list));
+		r = 1;
+		goto ERROR;
+	}
+
+	// Sorting must not change which ASes are in the list
+	loc_as_list_sort(list);
+
+	for (uint32_t number = 1; number < 100000; number++) {
+		if (loc_as_list_contains_number(list, number) != !(number % 2)) {
+			fprintf(stderr, "The AS list is wrong about AS%u\n", number);
+			r = 1;
+			goto ERROR;
+		}
+	}
+
+	if (!loc_as_list_contains_number(list, 0) || !loc_as_list_contains_number(list, 0xffffffff)) {
+		fprintf(stderr, "The AS list does not contain AS0 or AS4294967295\n");
+		r = 1;
+		goto ERROR;
+	}
+
+	loc_as_list_clear(list);
+
+	if (loc_as_list_contains_number(list, 2)) {
+		fprintf(stderr, "The AS list still contains AS2 after it has been cleared\n");
+		r = 1;
+		goto ERROR;
+	}
+
+ERROR:
+	loc_as_list_unref(list);
+
+	return r;
+}
+
 int main(int argc, char** argv) {
 	int err;
 
@@ -92,6 +225,67 @@ int main(int argc, char** argv) {
 		loc_as_unref(as);
 	}
 
+	// The same object must be returned every time
+	struct loc_as* as1 = NULL;
+	struct loc_as* as2 = NULL;
+
+	err = loc_database_get_as(db, &as1, 1);
+	if (err)
+		exit(EXIT_FAILURE);
+
+	err = loc_database_get_as(db, &as2, 1);
+	if (err)
+		exit(EXIT_FAILURE);
+
+	if (as1 != as2) {
+		fprintf(stderr, "AS1 has not been shared\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// Shared objects cannot be changed
+	err = loc_as_set_name(as1, "Changed");
+	if (!err || errno != EPERM) {
+		fprintf(stderr, "Could change the name of a shared AS\n");
+		exit(EXIT_FAILURE);
+	}
+
+	loc_as_unref(as1);
+	loc_as_unref(as2);
+
+	// Fetch all names without creating any objects
+	const char* as_name = NULL;
+	for (unsigned int i = 1; i <= TEST_AS_COUNT; i++) {
+		err = loc_database_get_as_name(db, i, &as_name);
+		if (err) {
+			fprintf(stderr, "Could not find the name of AS%u\n", i);
+			exit(EXIT_FAILURE);
+		}
+
+		sprintf(name, "Test AS%u", i);
+
+		if (strcmp(as_name, name) != 0) {
+			fprintf(stderr, "Unexpected name of AS%u: %s\n", i, as_name);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	// Check ASes that do not exist
+	const uint32_t missing[] = { 0, TEST_AS_COUNT + 1, 0xffffffff };
+
+	for (unsigned int i = 0; i < sizeof(missing) / sizeof(*missing); i++) {
+		err = loc_database_get_as(db, &as, missing[i]);
+		if (!err || as) {
+			fprintf(stderr, "Found AS%u which does not exist\n", missing[i]);
+			exit(EXIT_FAILURE);
+		}
+
+		err = loc_database_get_as_name(db, missing[i], &as_name);
+		if (!err || as_name) {
+			fprintf(stderr, "Found the name of AS%u which does not exist\n", missing[i]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
 	// Enumerator
 
 	struct loc_database_enumerator* enumerator;
@@ -120,7 +314,24 @@ int main(int argc, char** argv) {
 	}
 
 	loc_database_enumerator_unref(enumerator);
+
+	// Search for strings that are shorter and longer than a trigram
+	const char* strings[] = {
+		"1", "10", "as1", "AS12", "t as499", "Test AS4711", "test as", "st as", "s5", "xyz", "AS50000",
+	};
+
+	for (unsigned int i = 0; i < sizeof(strings) / sizeof(*strings); i++) {
+		err = check_search(db, strings[i]);
+		if (err)
+			exit(EXIT_FAILURE);
+	}
+
 	loc_database_unref(db);
+
+	err = check_list(ctx);
+	if (err)
+		exit(EXIT_FAILURE);
+
 	loc_unref(ctx);
 	fclose(f);
 
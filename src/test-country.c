@@ -23,10 +23,74 @@
 
 #include <libloc/libloc.h>
 #include <libloc/country.h>
+#include <libloc/country-list.h>
 #include <libloc/database.h>
 #include <libloc/network.h>
 #include <libloc/writer.h>
 
+static int check_list(struct loc_ctx* ctx) {
+	struct loc_country_list* list = NULL;
+	struct loc_country* country = NULL;
+	const char* codes[] = { "DE", "AA", "ZZ", "DE", "GB", NULL };
+	int r;
+
+	r = loc_country_list_new(ctx, &list);
+	if (r)
+		return r;
+
+	for (const char** code = codes; *code; code++) {
+		r = loc_country_new(ctx, &country, *code);
+		if (r)
+			goto ERROR;
+
+		r = loc_country_list_append(list, country);
+		loc_country_unref(country);
+		if (r)
+			goto ERROR;
+	}
+
+	// DE must only have been added once
+	if (loc_country_list_size(list) != 4) {
+		fprintf(stderr, "The country list has %zu elements\n", loc_country_list_size(list));
+		r = 1;
+		goto ERROR;
+	}
+
+	loc_country_list_sort(list);
+
+	for (const char** code = codes; *code; code++) {
+		if (!loc_country_list_contains_code(list, *code)) {
+			fprintf(stderr, "The country list does not contain %s\n", *code);
+			r = 1;
+			goto ERROR;
+		}
+	}
+
+	// Check codes that are not in the list or that are invalid
+	const char* missing[] = { "FR", "AB", "ZY", "", "D", "DEU", "de", "1A", NULL };
+
+	for (const char** code = missing; *code; code++) {
+		if (loc_country_list_contains_code(list, *code)) {
+			fprintf(stderr, "The country list contains %s\n", *code);
+			r = 1;
+			goto ERROR;
+		}
+	}
+
+	loc_country_list_clear(list);
+
+	if (loc_country_list_contains_code(list, "DE")) {
+		fprintf(stderr, "The country list still contains DE after it has been cleared\n");
+		r = 1;
+		goto ERROR;
+	}
+
+ERROR:
+	loc_country_list_unref(list);
+
+	return r;
+}
+
 int main(int argc, char** argv) {
 	struct loc_country* country;
 	int flag;
@@ -122,6 +186,14 @@ int main(int argc, char** argv) {
 	}
 	loc_country_unref(country);
 
+	// Add a country out of order
+	err = loc_writer_add_country(writer, &country, "AT");
+	if (err) {
+		fprintf(stderr, "Could not create country: AT\n");
+		exit(EXIT_FAILURE);
+	}
+	loc_country_unref(country);
+
 	FILE* f = tmpfile();
 	if (!f) {
 		fprintf(stderr, "Could not open file for writing: %m\n");
@@ -151,6 +223,73 @@ int main(int argc, char** argv) {
 	}
 	loc_country_unref(country);
 
+	// Countries must be found regardless of their order
+	err = loc_database_get_country(db, &country, "AT");
+	if (err || !country) {
+		fprintf(stderr, "Could not find country: AT\n");
+		exit(EXIT_FAILURE);
+	}
+	loc_country_unref(country);
+
+	err = loc_database_get_country(db, &country, "DE");
+	if (err || !country) {
+		fprintf(stderr, "Could not find country: DE\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (strcmp(loc_country_get_name(country), "Testistan") != 0) {
+		fprintf(stderr, "Got the wrong name for DE: %s\n", loc_country_get_name(country));
+		exit(EXIT_FAILURE);
+	}
+	loc_country_unref(country);
+
+	// The same object must be returned every time
+	struct loc_country* country1 = NULL;
+	struct loc_country* country2 = NULL;
+
+	err = loc_database_get_country(db, &country1, "DE");
+	if (err || !country1)
+		exit(EXIT_FAILURE);
+
+	err = loc_database_get_country(db, &country2, "DE");
+	if (err || !country2)
+		exit(EXIT_FAILURE);
+
+	if (country1 != country2) {
+		fprintf(stderr, "DE has not been shared\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// Shared objects cannot be changed
+	err = loc_country_set_name(country1, "Changed");
+	if (!err || errno != EPERM) {
+		fprintf(stderr, "Could change the name of a shared country\n");
+		exit(EXIT_FAILURE);
+	}
+
+	err = loc_country_set_continent_code(country1, "EU");
+	if (!err || errno != EPERM) {
+		fprintf(stderr, "Could change the continent of a shared country\n");
+		exit(EXIT_FAILURE);
+	}
+
+	loc_country_unref(country1);
+	loc_country_unref(country2);
+
+	// Look up a country that does not exist
+	err = loc_database_get_country(db, &country, "FR");
+	if (err || country) {
+		fprintf(stderr, "Found country FR which does not exist\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// Look up an invalid country code
+	err = loc_database_get_country(db, &country, "X1");
+	if (!err || errno != EINVAL) {
+		fprintf(stderr, "Invalid country code X1 has been accepted\n");
+		exit(EXIT_FAILURE);
+	}
+
 	struct loc_network* network = NULL;
 
 	// Create a test network
@@ -188,6 +327,11 @@ int main(int argc, char** argv) {
 	loc_network_unref(network);
 
 	loc_database_unref(db);
+
+	err = check_list(ctx);
+	if (err)
+		exit(EXIT_FAILURE);
+
 	loc_unref(ctx);
 	fclose(f);
 
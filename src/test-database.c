@@ -14,6 +14,7 @@
 	GNU General Public License for more details.
 */
 
+#include <arpa/inet.h>
 #include <stdio.h>
 #include <stddef.h>
 #include <stdlib.h>
@@ -25,9 +26,17 @@
 #include <syslog.h>
 
 #include <libloc/libloc.h>
+#include <libloc/address.h>
+#include <libloc/as.h>
+#include <libloc/as-list.h>
+#include <libloc/country.h>
+#include <libloc/country-list.h>
 #include <libloc/database.h>
+#include <libloc/network.h>
 #include <libloc/writer.h>
 
+#include "test.h"
+
 const char* VENDOR = "Test Vendor";
 const char* DESCRIPTION =
 	"Lorem ipsum dolor sit amet, consectetur adipiscing elit. "
@@ -67,6 +76,1094 @@ static int attempt_to_open(struct loc_ctx* ctx, const char* path) {
 	return r;
 }
 
+/*
+	Enumerates all networks of some ASNs and compares them with a search through all networks
+*/
+static int check_asns(struct loc_ctx* ctx, struct loc_database* db,
+		const uint32_t* asns, size_t length, int family) {
+	struct loc_database_enumerator* all = NULL;
+	struct loc_database_enumerator* enumerator = NULL;
+	struct loc_network* expected = NULL;
+	struct loc_network* network = NULL;
+	struct loc_as_list* list = NULL;
+	struct loc_as* as = NULL;
+	size_t count = 0;
+	int r;
+
+	r = loc_as_list_new(ctx, &list);
+	if (r)
+		return r;
+
+	for (unsigned int i = 0; i < length; i++) {
+		r = loc_as_new(ctx, &as, asns[i]);
+		if (r)
+			goto ERROR;
+
+		r = loc_as_list_append(list, as);
+		loc_as_unref(as);
+		if (r)
+			goto ERROR;
+	}
+
+	r = loc_database_enumerator_new(&all, db, LOC_DB_ENUMERATE_NETWORKS, 0);
+	if (r)
+		goto ERROR;
+
+	r = loc_database_enumerator_new(&enumerator, db, LOC_DB_ENUMERATE_NETWORKS, 0);
+	if (r)
+		goto ERROR;
+
+	r = loc_database_enumerator_set_asns(enumerator, list);
+	if (r)
+		goto ERROR;
+
+	if (family) {
+		r = loc_database_enumerator_set_family(enumerator, family);
+		if (r)
+			goto ERROR;
+	}
+
+	for (;;) {
+		// Find the next network that should match
+		for (;;) {
+			r = loc_database_enumerator_next_network(all, &expected);
+			if (r)
+				goto ERROR;
+
+			if (!expected)
+				break;
+
+			if ((!family || loc_network_address_family(expected) == family)) {
+				for (unsigned int i = 0; i < length; i++) {
+					if (loc_network_get_asn(expected) == asns[i])
+						goto FOUND;
+				}
+			}
+
+			loc_network_unref(expected);
+		}
+
+FOUND:
+		r = loc_database_enumerator_next_network(enumerator, &network);
+		if (r)
+			goto ERROR;
+
+		if (!expected && !network)
+			break;
+
+		if (!expected || !network || loc_network_cmp(expected, network) != 0
+				|| loc_network_get_asn(expected) != loc_network_get_asn(network)) {
+			fprintf(stderr, "Got network %s instead of %s\n",
+				(network) ? loc_network_str(network) : "nothing",
+				(expected) ? loc_network_str(expected) : "nothing");
+			r = 1;
+		}
+
+		if (expected)
+			loc_network_unref(expected);
+		if (network)
+			loc_network_unref(network);
+		if (r)
+			goto ERROR;
+
+		count++;
+	}
+
+	printf("Found %zu network(s) for %zu ASN(s)\n", count, length);
+
+ERROR:
+	if (enumerator)
+		loc_database_enumerator_unref(enumerator);
+	if (all)
+		loc_database_enumerator_unref(all);
+	loc_as_list_unref(list);
+
+	return r;
+}
+
+/*
+	Enumerates the flattened networks of some countries and compares them with a
+	search that has to walk through the tree because it includes an ASN which
+	does not exist
+*/
+static int check_countries(struct loc_ctx* ctx, struct loc_database* db,
+		const char** country_codes, int family) {
+	struct loc_database_enumerator* enumerators[2] = { NULL, NULL };
+	struct loc_network* results[2] = { NULL, NULL };
+	struct loc_country_list* countries = NULL;
+	struct loc_as_list* asns = NULL;
+	struct loc_country* country = NULL;
+	struct loc_as* as = NULL;
+	size_t count = 0;
+	int r;
+
+	r = loc_country_list_new(ctx, &countries);
+	if (r)
+		return r;
+
+	for (const char** country_code = country_codes; *country_code; country_code++) {
+		r = loc_country_new(ctx, &country, *country_code);
+		if (r)
+			goto ERROR;
+
+		r = loc_country_list_append(countries, country);
+		loc_country_unref(country);
+		if (r)
+			goto ERROR;
+	}
+
+	r = loc_as_list_new(ctx, &asns);
+	if (r)
+		goto ERROR;
+
+	r = loc_as_new(ctx, &as, 0xffffffff);
+	if (r)
+		goto ERROR;
+
+	r = loc_as_list_append(asns, as);
+	loc_as_unref(as);
+	if (r)
+		goto ERROR;
+
+	for (unsigned int i = 0; i < 2; i++) {
+		r = loc_database_enumerator_new(&enumerators[i], db,
+			LOC_DB_ENUMERATE_NETWORKS, LOC_DB_ENUMERATOR_FLAGS_FLATTEN);
+		if (r)
+			goto ERROR;
+
+		r = loc_database_enumerator_set_countries(enumerators[i], countries);
+		if (r)
+			goto ERROR;
+
+		if (family) {
+			r = loc_database_enumerator_set_family(enumerators[i], family);
+			if (r)
+				goto ERROR;
+		}
+	}
+
+	r = loc_database_enumerator_set_asns(enumerators[1], asns);
+	if (r)
+		goto ERROR;
+
+	for (;;) {
+		for (unsigned int i = 0; i < 2; i++) {
+			r = loc_database_enumerator_next_network(enumerators[i], &results[i]);
+			if (r)
+				goto ERROR;
+		}
+
+		if (!results[0] && !results[1])
+			break;
+
+		if (!results[0] || !results[1] || loc_network_cmp(results[0], results[1]) != 0
+				|| loc_network_properties_cmp(results[0], results[1]) != 0) {
+			fprintf(stderr, "Got network %s instead of %s\n",
+				(results[0]) ? loc_network_str(results[0]) : "nothing",
+				(results[1]) ? loc_network_str(results[1]) : "nothing");
+			r = 1;
+		}
+
+		for (unsigned int i = 0; i < 2; i++) {
+			if (results[i])
+				loc_network_unref(results[i]);
+		}
+		if (r)
+			goto ERROR;
+
+		count++;
+	}
+
+	printf("Found %zu network(s) for %zu countries\n",
+		count, loc_country_list_size(countries));
+
+ERROR:
+	for (unsigned int i = 0; i < 2; i++) {
+		if (enumerators[i])
+			loc_database_enumerator_unref(enumerators[i]);
+	}
+	if (asns)
+		loc_as_list_unref(asns);
+	loc_country_list_unref(countries);
+
+	return r;
+}
+
+/*
+	Creates an enumerator that is looking for one ASN and/or one country
+*/
+static int new_enumerator(struct loc_ctx* ctx, struct loc_database* db,
+		struct loc_database_enumerator** enumerator, enum loc_database_enumerator_mode mode,
+		int flags, uint32_t asn, const char* country_code) {
+	struct loc_country_list* countries = NULL;
+	struct loc_country* country = NULL;
+	struct loc_as_list* asns = NULL;
+	struct loc_as* as = NULL;
+	int r;
+
+	r = loc_database_enumerator_new(enumerator, db, mode, flags);
+	if (r)
+		return r;
+
+	if (asn) {
+		r = loc_as_list_new(ctx, &asns);
+		if (r)
+			goto ERROR;
+
+		r = loc_as_new(ctx, &as, asn);
+		if (r)
+			goto ERROR;
+
+		r = loc_as_list_append(asns, as);
+		if (r)
+			goto ERROR;
+
+		r = loc_database_enumerator_set_asns(*enumerator, asns);
+		if (r)
+			goto ERROR;
+	}
+
+	if (country_code) {
+		r = loc_country_list_new(ctx, &countries);
+		if (r)
+			goto ERROR;
+
+		r = loc_country_new(ctx, &country, country_code);
+		if (r)
+			goto ERROR;
+
+		r = loc_country_list_append(countries, country);
+		if (r)
+			goto ERROR;
+
+		r = loc_database_enumerator_set_countries(*enumerator, countries);
+		if (r)
+			goto ERROR;
+	}
+
+ERROR:
+	if (countries)
+		loc_country_list_unref(countries);
+	if (country)
+		loc_country_unref(country);
+	if (asns)
+		loc_as_list_unref(asns);
+	if (as)
+		loc_as_unref(as);
+
+	// Don't return a half-configured enumerator
+	if (r) {
+		loc_database_enumerator_unref(*enumerator);
+		*enumerator = NULL;
+	}
+
+	return r;
+}
+
+/*
+	Fetches the next network from the enumerator and compares it with info
+*/
+static int compare_next_network(struct loc_database_enumerator* enumerator,
+		const struct loc_network_info* info) {
+	struct loc_network* network = NULL;
+	int r;
+
+	r = loc_database_enumerator_next_network(enumerator, &network);
+	if (r)
+		return r;
+
+	if (!network) {
+		fprintf(stderr, "Got network %s/%u which should not exist\n",
+			loc_address_str(&info->first_address), info->prefix);
+		return 1;
+	}
+
+	if (info->family != loc_network_address_family(network)
+			|| info->prefix != loc_network_prefix(network)
+			|| loc_address_cmp(&info->first_address, loc_network_get_first_address(network))
+			|| loc_address_cmp(&info->last_address, loc_network_get_last_address(network))
+			|| strcmp(info->country_code, loc_network_get_country_code(network))
+			|| info->asn != loc_network_get_asn(network)
+			|| (uint32_t)info->flags != (uint32_t)loc_network_has_flag(network, 0xffff)) {
+		fprintf(stderr, "Got network %s/%u instead of %s\n",
+			loc_address_str(&info->first_address), info->prefix, loc_network_str(network));
+		r = 1;
+	}
+
+	loc_network_unref(network);
+
+	return r;
+}
+
+struct walk {
+	struct loc_database_enumerator* expected;
+	size_t count;
+	size_t stop;
+};
+
+static int walk_callback(const struct loc_network_info* info, void* data) {
+	struct walk* walk = data;
+	int r;
+
+	r = compare_next_network(walk->expected, info);
+	if (r)
+		return -1;
+
+	// Stop early if we have been asked to
+	if (++walk->count == walk->stop)
+		return 42;
+
+	return 0;
+}
+
+/*
+	Fetches networks in batches and through a callback and compares
+	them with the networks that loc_database_enumerator_next_network() returns
+*/
+static int check_batches(struct loc_ctx* ctx, struct loc_database* db,
+		enum loc_database_enumerator_mode mode, int flags, uint32_t asn, const char* country_code) {
+	struct loc_database_enumerator* expected = NULL;
+	struct loc_database_enumerator* enumerator = NULL;
+	struct loc_network* network = NULL;
+	struct loc_network_info batch[7];
+	struct walk walk = {};
+	size_t count = 0;
+	size_t total = 0;
+	int r;
+
+	r = new_enumerator(ctx, db, &expected, mode, flags, asn, country_code);
+	if (r)
+		goto ERROR;
+
+	r = new_enumerator(ctx, db, &enumerator, mode, flags, asn, country_code);
+	if (r)
+		goto ERROR;
+
+	do {
+		r = loc_database_enumerator_next_networks(enumerator,
+			batch, sizeof(batch) / sizeof(*batch), &count);
+		if (r)
+			goto ERROR;
+
+		for (unsigned int i = 0; i < count; i++) {
+			r = compare_next_network(expected, &batch[i]);
+			if (r)
+				goto ERROR;
+		}
+
+		total += count;
+	} while (count);
+
+	// There must not be any more networks
+	r = loc_database_enumerator_next_network(expected, &network);
+	if (r)
+		goto ERROR;
+
+	if (network) {
+		fprintf(stderr, "Missed network %s\n", loc_network_str(network));
+		loc_network_unref(network);
+		r = 1;
+		goto ERROR;
+	}
+
+	loc_database_enumerator_unref(expected);
+	loc_database_enumerator_unref(enumerator);
+	expected = enumerator = NULL;
+
+	r = new_enumerator(ctx, db, &walk.expected, mode, flags, asn, country_code);
+	if (r)
+		goto ERROR;
+
+	r = new_enumerator(ctx, db, &enumerator, mode, flags, asn, country_code);
+	if (r)
+		goto ERROR;
+
+	// Walk through half of the networks and stop
+	walk.stop = total / 2;
+
+	if (walk.stop) {
+		r = loc_database_enumerator_walk(enumerator, walk_callback, &walk);
+		if (r != 42) {
+			fprintf(stderr, "The walk did not stop: %d\n", r);
+			r = 1;
+			goto ERROR;
+		}
+	}
+
+	// Continue with the rest
+	r = loc_database_enumerator_walk(enumerator, walk_callback, &walk);
+	if (r)
+		goto ERROR;
+
+	if (walk.count != total) {
+		fprintf(stderr, "Walked through %zu network(s), expected %zu\n", walk.count, total);
+		r = 1;
+		goto ERROR;
+	}
+
+	printf("Fetched %zu network(s) in batches\n", total);
+
+ERROR:
+	if (walk.expected)
+		loc_database_enumerator_unref(walk.expected);
+	if (enumerator)
+		loc_database_enumerator_unref(enumerator);
+	if (expected)
+		loc_database_enumerator_unref(expected);
+
+	return r;
+}
+
+/*
+	Fetches all networks of the database at once
+*/
+static int fetch_networks(struct loc_ctx* ctx, struct loc_database* db, int flags,
+		uint32_t asn, const char* country_code, struct loc_network_info** list, size_t* length) {
+	struct loc_database_enumerator* enumerator = NULL;
+	size_t found = 0;
+	int r;
+
+	*list = NULL;
+	*length = 0;
+
+	r = new_enumerator(ctx, db, &enumerator, LOC_DB_ENUMERATE_NETWORKS, flags, asn, country_code);
+	if (r)
+		return r;
+
+	for (;;) {
+		*list = reallocarray(*list, *length + 1, sizeof(**list));
+		if (!*list) {
+			r = 1;
+			break;
+		}
+
+		r = loc_database_enumerator_next_networks(enumerator, &(*list)[*length], 1, &found);
+		if (r || !found)
+			break;
+
+		(*length)++;
+	}
+
+	loc_database_enumerator_unref(enumerator);
+
+	return r;
+}
+
+/*
+	Splits the database into ranges and checks that enumerating all of them
+	returns the same networks as enumerating the whole database at once
+*/
+static int check_partitions(struct loc_ctx* ctx, struct loc_database* db, int flags, size_t count) {
+	struct loc_database_enumerator* enumerator = NULL;
+	struct loc_database_range ranges[16];
+	struct loc_network_info* expected = NULL;
+	struct loc_network_info info;
+	size_t length = 0;
+	size_t found = 0;
+	size_t i = 0;
+	int r;
+
+	// Fetch all networks
+	r = fetch_networks(ctx, db, flags, 0, NULL, &expected, &length);
+	if (r)
+		goto ERROR;
+
+	r = loc_database_partition(db, ranges, &count);
+	if (r)
+		goto ERROR;
+
+	for (unsigned int p = 0; p < count; p++) {
+		r = loc_database_enumerator_new(&enumerator, db, LOC_DB_ENUMERATE_NETWORKS, flags);
+		if (r)
+			goto ERROR;
+
+		r = loc_database_enumerator_set_range(enumerator,
+			&ranges[p].first_address, &ranges[p].last_address);
+		if (r)
+			goto ERROR;
+
+		for (;;) {
+			r = loc_database_enumerator_next_networks(enumerator, &info, 1, &found);
+			if (r)
+				goto ERROR;
+
+			if (!found)
+				break;
+
+			if (i >= length || !info_equal(&info, &expected[i])) {
+				fprintf(stderr, "Got network %s/%u in range %u unexpectedly\n",
+					loc_address_str(&info.first_address), info.prefix, p);
+				r = 1;
+				goto ERROR;
+			}
+
+			i++;
+		}
+
+		// The range cannot be changed once the enumerator has started
+		if (!loc_database_enumerator_set_range(enumerator,
+				&ranges[p].first_address, &ranges[p].last_address) || errno != EBUSY) {
+			fprintf(stderr, "Could change the range of a running enumerator\n");
+			r = 1;
+			goto ERROR;
+		}
+
+		loc_database_enumerator_unref(enumerator);
+		enumerator = NULL;
+	}
+
+	if (i != length) {
+		fprintf(stderr, "Found %zu network(s) in all ranges, expected %zu\n", i, length);
+		r = 1;
+		goto ERROR;
+	}
+
+	printf("Found %zu network(s) in %zu range(s)\n", length, count);
+
+ERROR:
+	if (enumerator)
+		loc_database_enumerator_unref(enumerator);
+	free(expected);
+
+	return r;
+}
+
+/*
+	Enumerates the subtree of a network and checks that it returns the same
+	networks as enumerating the whole database and filtering the result
+*/
+static int check_subtree(struct loc_ctx* ctx, struct loc_database* db,
+		const char* subtree, int flags, const char* country_code) {
+	struct loc_database_enumerator* enumerator = NULL;
+	struct loc_network_info* list = NULL;
+	struct loc_network* network = NULL;
+	struct loc_network_info expected;
+	struct loc_network_info info;
+	size_t length = 0;
+	size_t found = 0;
+	size_t i = 0;
+	size_t count = 0;
+	int r;
+
+	r = loc_network_new_from_string(ctx, &network, subtree);
+	if (r)
+		return r;
+
+	const struct in6_addr* first = loc_network_get_first_address(network);
+	const struct in6_addr* last  = loc_network_get_last_address(network);
+
+	// Fetch all networks
+	r = fetch_networks(ctx, db, flags & ~LOC_DB_ENUMERATOR_FLAGS_SUPERNETS,
+		0, country_code, &list, &length);
+	if (r)
+		goto ERROR;
+
+	r = new_enumerator(ctx, db, &enumerator, LOC_DB_ENUMERATE_NETWORKS, flags, 0, country_code);
+	if (r)
+		goto ERROR;
+
+	r = loc_database_enumerator_set_network(enumerator, network);
+	if (r)
+		goto ERROR;
+
+	for (;;) {
+		r = loc_database_enumerator_next_networks(enumerator, &info, 1, &found);
+		if (r)
+			goto ERROR;
+
+		// Find the next network we expect
+		for (; i < length; i++) {
+			expected = list[i];
+
+			const int inside = loc_address_cmp(&expected.first_address, first) >= 0
+				&& loc_address_cmp(&expected.last_address, last) <= 0;
+			const int encloses = loc_address_cmp(&expected.first_address, first) <= 0
+				&& loc_address_cmp(&expected.last_address, last) >= 0;
+
+			if (inside)
+				break;
+
+			if (!encloses)
+				continue;
+
+			// Flattened networks are cut down to the subtree
+			if (flags & LOC_DB_ENUMERATOR_FLAGS_FLATTEN) {
+				expected.first_address = *first;
+				expected.last_address  = *last;
+				expected.prefix = loc_network_prefix(network);
+				break;
+			}
+
+			if (flags & LOC_DB_ENUMERATOR_FLAGS_SUPERNETS)
+				break;
+		}
+
+		if (!found)
+			break;
+
+		if (i++ >= length || !info_equal(&info, &expected)) {
+			fprintf(stderr, "Got network %s/%u in %s unexpectedly\n",
+				loc_address_str(&info.first_address), info.prefix, subtree);
+			r = 1;
+			goto ERROR;
+		}
+
+		count++;
+	}
+
+	if (i < length) {
+		fprintf(stderr, "Did not find %s/%u in %s\n",
+			loc_address_str(&list[i].first_address), list[i].prefix, subtree);
+		r = 1;
+		goto ERROR;
+	}
+
+	printf("Found %zu network(s) in %s\n", count, subtree);
+
+ERROR:
+	if (enumerator)
+		loc_database_enumerator_unref(enumerator);
+	loc_network_unref(network);
+	free(list);
+
+	return r;
+}
+
+/*
+	Pages through all networks, creating a new enumerator for every page that
+	resumes from the cursor of the previous one
+*/
+static int check_cursor(struct loc_ctx* ctx, struct loc_database* db,
+		int flags, uint32_t asn, const char* country_code, size_t page) {
+	struct loc_database_enumerator* enumerator = NULL;
+	struct loc_network_info* list = NULL;
+	struct loc_network_info info;
+	char cursor[LOC_DATABASE_CURSOR_LENGTH] = "";
+	size_t length = 0;
+	size_t found = 0;
+	size_t pages = 0;
+	size_t i = 0;
+	int r;
+
+	// Fetch all networks
+	r = fetch_networks(ctx, db, flags, asn, country_code, &list, &length);
+	if (r)
+		goto ERROR;
+
+	for (;;) {
+		r = new_enumerator(ctx, db, &enumerator, LOC_DB_ENUMERATE_NETWORKS, flags, asn, country_code);
+		if (r)
+			goto ERROR;
+
+		if (*cursor) {
+			r = loc_database_enumerator_set_cursor(enumerator, cursor);
+			if (r) {
+				fprintf(stderr, "Could not set cursor %s: %m\n", cursor);
+				goto ERROR;
+			}
+		}
+
+		for (unsigned int j = 0; j < page; j++) {
+			r = loc_database_enumerator_next_networks(enumerator, &info, 1, &found);
+			if (r)
+				goto ERROR;
+
+			if (!found)
+				break;
+
+			if (i >= length || !info_equal(&info, &list[i])) {
+				fprintf(stderr, "Got network %s/%u on page %zu unexpectedly\n",
+					loc_address_str(&info.first_address), info.prefix, pages);
+				r = 1;
+				goto ERROR;
+			}
+
+			i++;
+		}
+
+		r = loc_database_enumerator_get_cursor(enumerator, cursor, sizeof(cursor));
+		if (r)
+			goto ERROR;
+
+		loc_database_enumerator_unref(enumerator);
+		enumerator = NULL;
+
+		pages++;
+
+		if (!found)
+			break;
+	}
+
+	if (i != length) {
+		fprintf(stderr, "Found %zu network(s) on all pages, expected %zu\n", i, length);
+		r = 1;
+		goto ERROR;
+	}
+
+	// The last cursor must not return anything
+	r = new_enumerator(ctx, db, &enumerator, LOC_DB_ENUMERATE_NETWORKS, flags, asn, country_code);
+	if (r)
+		goto ERROR;
+
+	r = loc_database_enumerator_set_cursor(enumerator, cursor);
+	if (r)
+		goto ERROR;
+
+	r = loc_database_enumerator_next_networks(enumerator, &info, 1, &found);
+	if (r)
+		goto ERROR;
+
+	if (found) {
+		fprintf(stderr, "Got network %s/%u after the end\n",
+			loc_address_str(&info.first_address), info.prefix);
+		r = 1;
+		goto ERROR;
+	}
+
+	loc_database_enumerator_unref(enumerator);
+	enumerator = NULL;
+
+	// The cursor cannot be used with a different filter
+	r = new_enumerator(ctx, db, &enumerator, LOC_DB_ENUMERATE_NETWORKS,
+		flags ^ LOC_DB_ENUMERATOR_FLAGS_FLATTEN, asn, country_code);
+	if (r)
+		goto ERROR;
+
+	r = loc_database_enumerator_set_cursor(enumerator, cursor);
+	if (!r || errno != EINVAL) {
+		fprintf(stderr, "Could use cursor %s with a different filter\n", cursor);
+		r = 1;
+		goto ERROR;
+	}
+
+	// Reject anything that is not a cursor
+	r = loc_database_enumerator_set_cursor(enumerator, "cursor");
+	if (!r || errno != EINVAL) {
+		fprintf(stderr, "Could use an invalid cursor\n");
+		r = 1;
+		goto ERROR;
+	}
+
+	r = 0;
+
+	printf("Found %zu network(s) on %zu page(s)\n", length, pages);
+
+ERROR:
+	if (enumerator)
+		loc_database_enumerator_unref(enumerator);
+	free(list);
+
+	return r;
+}
+
+/*
+	Writes the database into a temporary file and returns its size
+*/
+static int write_database(struct loc_writer* writer, int flags, FILE** f, long* size) {
+	int r;
+
+	r = loc_writer_set_flags(writer, flags);
+	if (r)
+		return r;
+
+	*f = tmpfile();
+	if (!*f)
+		return 1;
+
+	r = loc_writer_write(writer, *f, LOC_DATABASE_VERSION_UNSET);
+	if (r)
+		return r;
+
+	*size = ftell(*f);
+	if (*size < 0)
+		return 1;
+
+	return 0;
+}
+
+static int check_network_indexes(struct loc_ctx* ctx) {
+	struct loc_database* db = NULL;
+	struct loc_network* network = NULL;
+	struct loc_writer* writer = NULL;
+	long indexed_size = 0;
+	long size = 0;
+	FILE* f = NULL;
+	char string[128];
+	int r;
+
+	r = loc_writer_new(ctx, &writer, NULL, NULL);
+	if (r)
+		return r;
+
+	// Add networks of various ASNs, some of them inside each other
+	for (unsigned int i = 0; i < 1024; i++) {
+		snprintf(string, sizeof(string), "10.%u.%u.0/24", i / 256, i % 256);
+
+		r = loc_writer_add_network(writer, &network, string);
+		if (r)
+			goto ERROR;
+
+		loc_network_set_asn(network, 1 + i % 7);
+		if (i % 3)
+			loc_network_set_country_code(network, (i % 3 == 1) ? "DE" : "FR");
+		loc_network_unref(network);
+
+		snprintf(string, sizeof(string), "2001:db8:%x::/48", i);
+
+		r = loc_writer_add_network(writer, &network, string);
+		if (r)
+			goto ERROR;
+
+		loc_network_set_asn(network, 1 + i % 5);
+		loc_network_set_country_code(network, (i % 5) ? "DE" : "CH");
+		loc_network_unref(network);
+	}
+
+	for (unsigned int i = 0; i < 4; i++) {
+		snprintf(string, sizeof(string), "10.%u.0.0/16", i);
+
+		r = loc_writer_add_network(writer, &network, string);
+		if (r)
+			goto ERROR;
+
+		loc_network_set_asn(network, 1 + i);
+		loc_network_set_country_code(network, (i % 2) ? "AT" : "FR");
+		loc_network_unref(network);
+	}
+
+	// Add some networks that contain all others
+	const char* supernets[] = { "10.0.0.0/8", "2001:db8::/32", NULL };
+
+	for (const char** supernet = supernets; *supernet; supernet++) {
+		r = loc_writer_add_network(writer, &network, *supernet);
+		if (r)
+			goto ERROR;
+
+		loc_network_set_country_code(network, "AT");
+		loc_network_unref(network);
+	}
+
+	const uint32_t asns[] = { 1, 2, 3, 4, 5, 6, 7, 8, 0 };
+	const char* all_countries[] = { "AT", "CH", "DE", "FR", NULL };
+
+	// Write the database without any indexes first
+	r = write_database(writer, 0, &f, &size);
+	if (r)
+		goto ERROR;
+
+	r = loc_database_new(ctx, &db, f);
+	if (r)
+		goto ERROR;
+
+	// The enumerators must find the same networks by walking the tree
+	r = check_asns(ctx, db, asns, 8, 0);
+	if (r)
+		goto ERROR;
+
+	r = check_countries(ctx, db, all_countries, 0);
+	if (r)
+		goto ERROR;
+
+	r = check_cursor(ctx, db, LOC_DB_ENUMERATOR_FLAGS_FLATTEN, 0, "DE", 7);
+	if (r)
+		goto ERROR;
+
+	loc_database_unref(db);
+	db = NULL;
+	fclose(f);
+	f = NULL;
+
+	// Write the database again with all indexes
+	r = write_database(writer,
+		LOC_WRITER_INDEX_AS_NETWORKS|LOC_WRITER_INDEX_COUNTRY_NETWORKS, &f, &indexed_size);
+	if (r)
+		goto ERROR;
+
+	if (indexed_size <= size) {
+		fprintf(stderr, "Database with indexes has %ld bytes, without %ld bytes\n",
+			indexed_size, size);
+		r = 1;
+		goto ERROR;
+	}
+
+	r = loc_database_new(ctx, &db, f);
+	if (r)
+		goto ERROR;
+
+	// Search for one ASN at a time
+	for (unsigned int i = 0; i < sizeof(asns) / sizeof(*asns); i++) {
+		r = check_asns(ctx, db, &asns[i], 1, 0);
+		if (r)
+			goto ERROR;
+	}
+
+	// Search for many ASNs at once
+	r = check_asns(ctx, db, asns, 3, 0);
+	if (r)
+		goto ERROR;
+
+	r = check_asns(ctx, db, asns, 8, AF_INET);
+	if (r)
+		goto ERROR;
+
+	r = check_asns(ctx, db, asns, 8, AF_INET6);
+	if (r)
+		goto ERROR;
+
+	// Search for hundreds of ASNs, most of which have no networks
+	uint32_t many_asns[300];
+
+	for (unsigned int i = 0; i < sizeof(many_asns) / sizeof(*many_asns); i++)
+		many_asns[i] = (i % 37) ? 64512 + i : asns[(i / 37) % 8];
+
+	r = check_asns(ctx, db, many_asns, sizeof(many_asns) / sizeof(*many_asns), 0);
+	if (r)
+		goto ERROR;
+
+	// Search for the flattened networks of some countries
+	const char* countries[][4] = {
+		{ "AT", NULL },
+		{ "DE", NULL },
+		{ "FR", NULL },
+		{ "CH", NULL },
+		{ "US", NULL },
+		{ "DE", "FR", NULL },
+		{ "AT", "CH", "DE", NULL },
+	};
+
+	for (unsigned int i = 0; i < sizeof(countries) / sizeof(*countries); i++) {
+		r = check_countries(ctx, db, countries[i], 0);
+		if (r)
+			goto ERROR;
+	}
+
+	r = check_countries(ctx, db, countries[6], AF_INET);
+	if (r)
+		goto ERROR;
+
+	r = check_countries(ctx, db, countries[6], AF_INET6);
+	if (r)
+		goto ERROR;
+
+	// Fetch networks without creating objects
+	r = check_batches(ctx, db, LOC_DB_ENUMERATE_NETWORKS, 0, 0, NULL);
+	if (r)
+		goto ERROR;
+
+	r = check_batches(ctx, db, LOC_DB_ENUMERATE_NETWORKS, 0, 3, NULL);
+	if (r)
+		goto ERROR;
+
+	r = check_batches(ctx, db, LOC_DB_ENUMERATE_NETWORKS, 0, 0, "DE");
+	if (r)
+		goto ERROR;
+
+	r = check_batches(ctx, db, LOC_DB_ENUMERATE_NETWORKS,
+		LOC_DB_ENUMERATOR_FLAGS_FLATTEN, 0, NULL);
+	if (r)
+		goto ERROR;
+
+	r = check_batches(ctx, db, LOC_DB_ENUMERATE_NETWORKS,
+		LOC_DB_ENUMERATOR_FLAGS_FLATTEN, 0, "AT");
+	if (r)
+		goto ERROR;
+
+	r = check_batches(ctx, db, LOC_DB_ENUMERATE_BOGONS, 0, 0, NULL);
+	if (r)
+		goto ERROR;
+
+	// Split the database into ranges
+	for (unsigned int i = 1; i <= 16; i *= 2) {
+		r = check_partitions(ctx, db, 0, i);
+		if (r)
+			goto ERROR;
+
+		r = check_partitions(ctx, db, LOC_DB_ENUMERATOR_FLAGS_FLATTEN, i);
+		if (r)
+			goto ERROR;
+	}
+
+	// Enumerate only parts of the tree
+	const char* subtrees[] = {
+		"10.1.0.0/16", "10.0.0.0/8", "10.2.3.0/24", "10.0.0.0/12", "192.168.0.0/16",
+		"2001:db8::/32", "2001:db8:100::/40", "2001:db8:1:1::/64", "::/0", NULL,
+	};
+
+	for (const char** subtree = subtrees; *subtree; subtree++) {
+		r = check_subtree(ctx, db, *subtree, 0, NULL);
+		if (r)
+			goto ERROR;
+
+		r = check_subtree(ctx, db, *subtree, LOC_DB_ENUMERATOR_FLAGS_SUPERNETS, NULL);
+		if (r)
+			goto ERROR;
+
+		r = check_subtree(ctx, db, *subtree, LOC_DB_ENUMERATOR_FLAGS_FLATTEN, NULL);
+		if (r)
+			goto ERROR;
+
+		r = check_subtree(ctx, db, *subtree, LOC_DB_ENUMERATOR_FLAGS_SUPERNETS, "AT");
+		if (r)
+			goto ERROR;
+
+		r = check_subtree(ctx, db, *subtree, LOC_DB_ENUMERATOR_FLAGS_FLATTEN, "DE");
+		if (r)
+			goto ERROR;
+	}
+
+	// Page through the networks
+	const size_t pages[] = { 1, 7, 100, 5000, 0 };
+
+	for (const size_t* page = pages; *page; page++) {
+		r = check_cursor(ctx, db, 0, 0, NULL, *page);
+		if (r)
+			goto ERROR;
+
+		r = check_cursor(ctx, db, 0, 0, "DE", *page);
+		if (r)
+			goto ERROR;
+
+		r = check_cursor(ctx, db, 0, 3, NULL, *page);
+		if (r)
+			goto ERROR;
+
+		r = check_cursor(ctx, db, LOC_DB_ENUMERATOR_FLAGS_FLATTEN, 0, NULL, *page);
+		if (r)
+			goto ERROR;
+
+		r = check_cursor(ctx, db, LOC_DB_ENUMERATOR_FLAGS_FLATTEN, 0, "AT", *page);
+		if (r)
+			goto ERROR;
+
+		// Resume through the flattened networks of a country in the index
+		r = check_cursor(ctx, db, LOC_DB_ENUMERATOR_FLAGS_FLATTEN, 0, "DE", *page);
+		if (r)
+			goto ERROR;
+	}
+
+	// Walk through the tree again without remembering visited nodes
+	r = loc_database_validate(db);
+	if (r)
+		goto ERROR;
+
+	r = check_asns(ctx, db, asns, 8, 0);
+	if (r)
+		goto ERROR;
+
+	r = check_countries(ctx, db, countries[6], 0);
+	if (r)
+		goto ERROR;
+
+ERROR:
+	if (db)
+		loc_database_unref(db);
+	if (f)
+		fclose(f);
+	loc_writer_unref(writer);
+
+	return r;
+}
+
 int main(int argc, char** argv) {
 	int err;
 
@@ -222,6 +1319,13 @@ int main(int argc, char** argv) {
 	// Free the enumerator
 	loc_database_enumerator_unref(enumerator);
 
+	// Search through the network indexes
+	err = check_network_indexes(ctx);
+	if (err) {
+		fprintf(stderr, "Could not search through the network indexes\n");
+		exit(EXIT_FAILURE);
+	}
+
 	// Close the database
 	loc_database_unref(db);
 	loc_unref(ctx);
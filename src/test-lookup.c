@@ -0,0 +1,850 @@
+/*
+	libloc - A library to determine the location of someone on the Internet
+
+	Copyright (C) 2024 IPFire Development Team <info@ipfire.org>
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+*/
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libloc/libloc.h>
+#include <libloc/address.h>
+#include <libloc/database.h>
+#include <libloc/format.h>
+#include <libloc/network.h>
+#include <libloc/writer.h>
+
+#include "test.h"
+
+#define TEST_ADDRESSES 100000
+
+static const char* addresses[] = {
+	"81.3.27.38",
+	"1.1.1.1",
+	"8.8.8.8",
+	"255.255.255.255",
+	"0.0.0.0",
+	"2001:db8::1",
+	"2a00:1450:4001:82a::200e",
+	"::1",
+	"::",
+	NULL,
+};
+
+/*
+	Addresses that must fall back to a less specific network because the tree
+	has more specific networks further down their path
+*/
+static const struct fallback {
+	const char* address;
+	const char* network;
+} fallbacks[] = {
+	{ "151.183.80.146", "151.183.0.0/16" },
+	{ "121.91.146.158", "120.0.0.0/6" },
+	{ NULL, NULL },
+};
+
+static int compare(struct loc_database* db, const struct in6_addr* address) {
+	struct loc_network_info info;
+	struct loc_network* network = NULL;
+	int r;
+
+	r = loc_database_lookup(db, address, &network);
+	if (r) {
+		fprintf(stderr, "Could not lookup %s: %m\n", loc_address_str(address));
+		return 1;
+	}
+
+	r = loc_database_lookup_info(db, address, &info);
+	if (r) {
+		fprintf(stderr, "Could not lookup info for %s: %m\n", loc_address_str(address));
+		goto ERROR;
+	}
+
+	// Check if both found nothing
+	if (!network) {
+		if (info.family != AF_UNSPEC) {
+			fprintf(stderr, "Unexpected result for %s\n", loc_address_str(address));
+			r = 1;
+		}
+
+		goto ERROR;
+	}
+
+	r = 1;
+
+	if (info.family != loc_network_address_family(network)) {
+		fprintf(stderr, "%s: Family does not match\n", loc_network_str(network));
+		goto ERROR;
+	}
+
+	if (info.prefix != loc_network_prefix(network)) {
+		fprintf(stderr, "%s: Prefix does not match: %u\n", loc_network_str(network), info.prefix);
+		goto ERROR;
+	}
+
+	if (loc_address_cmp(&info.first_address, loc_network_get_first_address(network)) != 0) {
+		fprintf(stderr, "%s: First address does not match\n", loc_network_str(network));
+		goto ERROR;
+	}
+
+	if (loc_address_cmp(&info.last_address, loc_network_get_last_address(network)) != 0) {
+		fprintf(stderr, "%s: Last address does not match\n", loc_network_str(network));
+		goto ERROR;
+	}
+
+	if (strcmp(info.country_code, loc_network_get_country_code(network)) != 0) {
+		fprintf(stderr, "%s: Country code does not match: %s\n",
+			loc_network_str(network), info.country_code);
+		goto ERROR;
+	}
+
+	if (info.asn != loc_network_get_asn(network)) {
+		fprintf(stderr, "%s: ASN does not match: %u\n", loc_network_str(network), info.asn);
+		goto ERROR;
+	}
+
+	for (unsigned int flag = 1; flag <= 0xffff; flag <<= 1) {
+		if (!loc_network_has_flag(network, flag) != !(info.flags & flag)) {
+			fprintf(stderr, "%s: Flags do not match\n", loc_network_str(network));
+			goto ERROR;
+		}
+	}
+
+	r = 0;
+
+ERROR:
+	if (network)
+		loc_network_unref(network);
+
+	return r;
+}
+
+static int check_fallback(struct loc_database* db, const struct fallback* fallback) {
+	struct loc_network* network = NULL;
+	int r;
+
+	r = loc_database_lookup_from_string(db, fallback->address, &network);
+	if (r) {
+		fprintf(stderr, "Could not lookup %s: %m\n", fallback->address);
+		return 1;
+	}
+
+	if (!network) {
+		fprintf(stderr, "Could not find %s\n", fallback->address);
+		return 1;
+	}
+
+	if (strcmp(loc_network_str(network), fallback->network) != 0) {
+		fprintf(stderr, "%s: Expected %s, got %s\n", fallback->address,
+			fallback->network, loc_network_str(network));
+		r = 1;
+	}
+
+	loc_network_unref(network);
+
+	return r;
+}
+
+static int check_many(struct loc_database* db, size_t batch) {
+	struct loc_network_info info;
+	int r = 1;
+
+	struct in6_addr* input = calloc(TEST_ADDRESSES, sizeof(*input));
+	struct loc_network_info* results = calloc(TEST_ADDRESSES, sizeof(*results));
+	if (!input || !results)
+		goto ERROR;
+
+	for (unsigned int i = 0; i < TEST_ADDRESSES; i++)
+		random_address(&input[i], (i % 3) ? AF_INET : AF_INET6);
+
+	// Lookup everything in batches
+	for (size_t i = 0; i < TEST_ADDRESSES; i += batch) {
+		size_t length = TEST_ADDRESSES - i;
+		if (length > batch)
+			length = batch;
+
+		r = loc_database_lookup_many(db, &input[i], length, &results[i]);
+		if (r) {
+			fprintf(stderr, "Could not lookup batch at %zu: %m\n", i);
+			goto ERROR;
+		}
+	}
+
+	// Compare each result
+	for (unsigned int i = 0; i < TEST_ADDRESSES; i++) {
+		r = loc_database_lookup_info(db, &input[i], &info);
+		if (r) {
+			fprintf(stderr, "Could not lookup info for %s: %m\n",
+				loc_address_str(&input[i]));
+			goto ERROR;
+		}
+
+		if (!info_equal(&info, &results[i])) {
+			fprintf(stderr, "Batch lookup (%zu) of %s does not match\n",
+				batch, loc_address_str(&input[i]));
+			r = 1;
+			goto ERROR;
+		}
+	}
+
+ERROR:
+	if (input)
+		free(input);
+	if (results)
+		free(results);
+
+	return r;
+}
+
+static int check_lookup4(struct loc_database* db, const struct in6_addr* address) {
+	struct loc_network_info info1;
+	struct loc_network_info info2;
+	int r;
+
+	r = loc_database_lookup_info(db, address, &info1);
+	if (r) {
+		fprintf(stderr, "Could not lookup info for %s: %m\n", loc_address_str(address));
+		return r;
+	}
+
+	r = loc_database_lookup4(db, ntohl(address->s6_addr32[3]), &info2);
+	if (r) {
+		fprintf(stderr, "Could not lookup %s as IPv4: %m\n", loc_address_str(address));
+		return r;
+	}
+
+	if (!info_equal(&info1, &info2)) {
+		fprintf(stderr, "IPv4 lookup of %s does not match\n", loc_address_str(address));
+		return 1;
+	}
+
+	return 0;
+}
+
+static int check_without_ipv4(struct loc_ctx* ctx) {
+	struct loc_database* db = NULL;
+	struct loc_writer* writer = NULL;
+	struct loc_network* network = NULL;
+	struct loc_network_info info;
+	FILE* f = NULL;
+	int r;
+
+	r = loc_writer_new(ctx, &writer, NULL, NULL);
+	if (r)
+		goto ERROR;
+
+	r = loc_writer_add_network(writer, &network, "2001:db8::/32");
+	if (r)
+		goto ERROR;
+
+	loc_network_unref(network);
+
+	f = tmpfile();
+	if (!f) {
+		r = 1;
+		goto ERROR;
+	}
+
+	r = loc_writer_write(writer, f, LOC_DATABASE_VERSION_UNSET);
+	if (r)
+		goto ERROR;
+
+	r = loc_database_new(ctx, &db, f);
+	if (r)
+		goto ERROR;
+
+	// There must not be any results
+	r = loc_database_lookup4(db, 0x01010101, &info);
+	if (r)
+		goto ERROR;
+
+	if (info.family != AF_UNSPEC) {
+		fprintf(stderr, "Found an IPv4 network in a database without any\n");
+		r = 1;
+		goto ERROR;
+	}
+
+	// The IPv6 network must still be found
+	r = loc_database_lookup_from_string(db, "2001:db8::1", &network);
+	if (r)
+		goto ERROR;
+
+	if (!network) {
+		fprintf(stderr, "Could not find 2001:db8::1\n");
+		r = 1;
+		goto ERROR;
+	}
+
+	loc_network_unref(network);
+
+ERROR:
+	if (r)
+		fprintf(stderr, "Could not check a database without IPv4: %m\n");
+	if (db)
+		loc_database_unref(db);
+	if (writer)
+		loc_writer_unref(writer);
+	if (f)
+		fclose(f);
+
+	return r;
+}
+
+static int check_cache(struct loc_database* db, size_t size) {
+	struct loc_database_cache* cache = NULL;
+	struct loc_network* network1 = NULL;
+	struct loc_network* network2 = NULL;
+	struct in6_addr address;
+	struct in6_addr found;
+	int r;
+
+	r = loc_database_cache_new(&cache, db, size, 24, 48);
+	if (r) {
+		fprintf(stderr, "Could not create cache: %m\n");
+		return r;
+	}
+
+	for (unsigned int i = 0; i < TEST_ADDRESSES; i++) {
+		// Every now and then pick a new address
+		if (i % 16 == 0)
+			random_address(&address, (i % 32) ? AF_INET6 : AF_INET);
+
+		// Otherwise change some of the last bits so that the address stays in its bucket
+		else
+			address.s6_addr[15] = random();
+
+		r = loc_database_lookup(db, &address, &network1);
+		if (r)
+			goto ERROR;
+
+		r = loc_database_cache_lookup(cache, &address, &network2);
+		if (r)
+			goto ERROR;
+
+		if (!network1 != !network2 || (network1 && loc_network_cmp(network1, network2))) {
+			fprintf(stderr, "Cached lookup of %s does not match\n", loc_address_str(&address));
+			r = 1;
+			goto ERROR;
+		}
+
+		if (network1) {
+			loc_network_unref(network1);
+			network1 = NULL;
+		}
+
+		if (network2) {
+			found = address;
+
+			loc_network_unref(network2);
+			network2 = NULL;
+		}
+	}
+
+	// Cached networks are shared and must not be changed
+	r = loc_database_cache_lookup(cache, &found, &network2);
+	if (r)
+		goto ERROR;
+
+	if (!network2) {
+		fprintf(stderr, "Could not find %s in the cache\n", loc_address_str(&found));
+		r = 1;
+		goto ERROR;
+	}
+
+	if (!loc_network_set_asn(network2, 1) || errno != EPERM
+			|| !loc_network_set_country_code(network2, "XX") || errno != EPERM
+			|| !loc_network_set_flag(network2, LOC_NETWORK_FLAG_ANYCAST) || errno != EPERM) {
+		fprintf(stderr, "Could change a cached network\n");
+		r = 1;
+		goto ERROR;
+	}
+
+	// Check the counters
+	if (loc_database_cache_hits(cache) + loc_database_cache_misses(cache) != TEST_ADDRESSES + 1) {
+		fprintf(stderr, "Cache counters do not add up\n");
+		r = 1;
+		goto ERROR;
+	}
+
+	if (!loc_database_cache_hits(cache)) {
+		fprintf(stderr, "Cache has not been hit\n");
+		r = 1;
+		goto ERROR;
+	}
+
+ERROR:
+	if (network1)
+		loc_network_unref(network1);
+	if (network2)
+		loc_network_unref(network2);
+	loc_database_cache_unref(cache);
+
+	return r;
+}
+
+/*
+	Checks that two databases enumerate the same networks
+*/
+static int check_enumerator(struct loc_database* db1, struct loc_database* db2) {
+	struct loc_database_enumerator* e1 = NULL;
+	struct loc_database_enumerator* e2 = NULL;
+	struct loc_network* n1 = NULL;
+	struct loc_network* n2 = NULL;
+	int r;
+
+	r = loc_database_enumerator_new(&e1, db1, LOC_DB_ENUMERATE_NETWORKS, 0);
+	if (r)
+		goto ERROR;
+
+	r = loc_database_enumerator_new(&e2, db2, LOC_DB_ENUMERATE_NETWORKS, 0);
+	if (r)
+		goto ERROR;
+
+	for (;;) {
+		r = loc_database_enumerator_next_network(e1, &n1);
+		if (r)
+			goto ERROR;
+
+		r = loc_database_enumerator_next_network(e2, &n2);
+		if (r)
+			goto ERROR;
+
+		// Both must end at the same time
+		if (!n1 || !n2)
+			break;
+
+		if (loc_network_cmp(n1, n2) != 0) {
+			fprintf(stderr, "Enumerated %s instead of %s\n",
+				loc_network_str(n2), loc_network_str(n1));
+			r = 1;
+			goto ERROR;
+		}
+
+		loc_network_unref(n1);
+		loc_network_unref(n2);
+		n1 = n2 = NULL;
+	}
+
+	if (n1 || n2) {
+		fprintf(stderr, "Enumerators returned a different number of networks\n");
+		r = 1;
+	}
+
+ERROR:
+	if (n1)
+		loc_network_unref(n1);
+	if (n2)
+		loc_network_unref(n2);
+	if (e1)
+		loc_database_enumerator_unref(e1);
+	if (e2)
+		loc_database_enumerator_unref(e2);
+
+	return r;
+}
+
+static int check_index(struct loc_ctx* ctx, FILE* f, struct loc_database* db,
+		int flags, int validate) {
+	struct loc_database* indexed_db = NULL;
+	struct loc_network_info info1;
+	struct loc_network_info info2;
+	struct in6_addr address;
+	int r;
+
+	r = loc_database_new(ctx, &indexed_db, f);
+	if (r) {
+		fprintf(stderr, "Could not load the database: %m\n");
+		return r;
+	}
+
+	r = loc_database_build_index(indexed_db, flags);
+	if (r) {
+		fprintf(stderr, "Could not build index %d: %m\n", flags);
+		goto ERROR;
+	}
+
+	if (validate) {
+		r = loc_database_validate(indexed_db);
+		if (r) {
+			fprintf(stderr, "Could not validate the database: %m\n");
+			goto ERROR;
+		}
+	}
+
+	for (unsigned int i = 0; i < TEST_ADDRESSES; i++) {
+		random_address(&address, (i % 2) ? AF_INET6 : AF_INET);
+
+		r = loc_database_lookup_info(db, &address, &info1);
+		if (r)
+			goto ERROR;
+
+		r = loc_database_lookup_info(indexed_db, &address, &info2);
+		if (r)
+			goto ERROR;
+
+		if (!info_equal(&info1, &info2)) {
+			fprintf(stderr, "Lookup of %s with index %d does not match\n",
+				loc_address_str(&address), flags);
+			r = 1;
+			goto ERROR;
+		}
+
+		// Check the IPv4 lookup, too
+		if (IN6_IS_ADDR_V4MAPPED(&address)) {
+			r = check_lookup4(indexed_db, &address);
+			if (r)
+				goto ERROR;
+		}
+
+		// Check the regular lookup
+		r = compare(indexed_db, &address);
+		if (r)
+			goto ERROR;
+	}
+
+	// Check that less specific networks are found
+	for (const struct fallback* fallback = fallbacks; fallback->address; fallback++) {
+		r = check_fallback(indexed_db, fallback);
+		if (r)
+			goto ERROR;
+	}
+
+	// Check batch lookups
+	r = check_many(indexed_db, 256);
+	if (r)
+		goto ERROR;
+
+	// Check the cache
+	r = check_cache(indexed_db, 1024);
+	if (r)
+		goto ERROR;
+
+	// Check that all networks can be enumerated
+	if (validate) {
+		r = check_enumerator(db, indexed_db);
+		if (r)
+			goto ERROR;
+	}
+
+ERROR:
+	loc_database_unref(indexed_db);
+
+	return r;
+}
+
+/*
+	Overwrites one 32 bit value in a copy of the database and checks that
+	validation fails, but that the database can still be used safely
+*/
+static int check_corrupted(struct loc_ctx* ctx, const char* data, size_t length,
+		size_t offset, uint32_t value) {
+	struct loc_database* db = NULL;
+	struct loc_network_info results[64];
+	struct loc_network_info info4;
+	struct loc_network_info info;
+	struct in6_addr addresses[64];
+	struct in6_addr address;
+	int r = 1;
+
+	FILE* f = tmpfile();
+	if (!f)
+		return 1;
+
+	if (fwrite(data, 1, offset, f) != offset)
+		goto ERROR;
+
+	value = htobe32(value);
+
+	if (fwrite(&value, 1, sizeof(value), f) != sizeof(value))
+		goto ERROR;
+
+	offset += sizeof(value);
+
+	if (fwrite(data + offset, 1, length - offset, f) != length - offset)
+		goto ERROR;
+
+	fflush(f);
+
+	r = loc_database_new(ctx, &db, f);
+	if (r) {
+		fprintf(stderr, "Could not load the corrupted database: %m\n");
+		goto ERROR;
+	}
+
+	r = loc_database_validate(db);
+	if (!r || errno != EBADMSG) {
+		fprintf(stderr, "Validated a corrupted database\n");
+		r = 1;
+		goto ERROR;
+	}
+
+	// Lookups must still be safe (they might fail, but never crash)
+	for (unsigned int i = 0; i < 100; i++) {
+		random_address(&address, (i % 2) ? AF_INET6 : AF_INET);
+
+		loc_database_lookup_info(db, &address, &info);
+	}
+
+	// IPv4 lookups must fail (or succeed) just like the regular lookup
+	for (unsigned int i = 0; i < 100; i++) {
+		random_address(&address, AF_INET);
+
+		int r1 = loc_database_lookup_info(db, &address, &info);
+		int r2 = loc_database_lookup4(db, ntohl(address.s6_addr32[3]), &info4);
+
+		if (!r1 != !r2 || !info_equal(&info, &info4)) {
+			fprintf(stderr, "IPv4 lookup of %s does not match in a corrupted database\n",
+				loc_address_str(&address));
+			r = 1;
+			goto ERROR;
+		}
+	}
+
+	r = loc_address_parse(&address, NULL, "8000::1");
+	if (r)
+		goto ERROR;
+
+	loc_database_lookup_info(db, &address, &info);
+
+	// Batches must set every result, even if they fail
+	for (unsigned int i = 0; i < 64; i++)
+		random_address(&addresses[i], (i % 2) ? AF_INET6 : AF_INET);
+
+	memset(results, 0xff, sizeof(results));
+
+	loc_database_lookup_many(db, addresses, 64, results);
+
+	for (unsigned int i = 0; i < 64; i++) {
+		switch (results[i].family) {
+			case AF_UNSPEC:
+			case AF_INET:
+			case AF_INET6:
+				break;
+
+			default:
+				fprintf(stderr, "Batch lookup left result %u unset\n", i);
+				r = 1;
+				goto ERROR;
+		}
+	}
+
+	r = 0;
+
+ERROR:
+	if (db)
+		loc_database_unref(db);
+	fclose(f);
+
+	return r;
+}
+
+static int check_validate(struct loc_ctx* ctx) {
+	char* data = NULL;
+	int r = 1;
+
+	FILE* f = fopen(ABS_SRCDIR "/data/database.db", "r");
+	if (!f)
+		return 1;
+
+	// Read the entire database
+	fseek(f, 0, SEEK_END);
+	const size_t length = ftell(f);
+	rewind(f);
+
+	data = malloc(length);
+	if (!data)
+		goto ERROR;
+
+	if (fread(data, 1, length, f) != length)
+		goto ERROR;
+
+	const struct loc_database_header_v1* header =
+		(const struct loc_database_header_v1*)(data + LOC_DATABASE_MAGIC_SIZE);
+
+	const size_t tree = be32toh(header->network_tree_offset);
+	const size_t nodes = be32toh(header->network_tree_length)
+		/ sizeof(struct loc_database_network_node_v1);
+	const size_t networks = be32toh(header->network_data_length)
+		/ sizeof(struct loc_database_network_v1);
+
+	// A node that does not exist
+	r = check_corrupted(ctx, data, length,
+		tree + offsetof(struct loc_database_network_node_v1, one), nodes);
+	if (r)
+		goto ERROR;
+
+	// A node that does not exist on the path to the IPv4 networks
+	r = check_corrupted(ctx, data, length,
+		tree + offsetof(struct loc_database_network_node_v1, zero), nodes);
+	if (r)
+		goto ERROR;
+
+	// A node that can be reached twice
+	r = check_corrupted(ctx, data, length,
+		tree + (nodes - 1) * sizeof(struct loc_database_network_node_v1)
+			+ offsetof(struct loc_database_network_node_v1, zero), 1);
+	if (r)
+		goto ERROR;
+
+	// A network that does not exist
+	r = check_corrupted(ctx, data, length,
+		tree + offsetof(struct loc_database_network_node_v1, network), networks);
+	if (r)
+		goto ERROR;
+
+ERROR:
+	if (data)
+		free(data);
+	fclose(f);
+
+	return r;
+}
+
+int main(int argc, char** argv) {
+	struct in6_addr address;
+	int err;
+
+	struct loc_ctx* ctx;
+	err = loc_new(&ctx);
+	if (err < 0)
+		exit(EXIT_FAILURE);
+
+	// Open the database
+	FILE* f = fopen(ABS_SRCDIR "/data/database.db", "r");
+	if (!f) {
+		fprintf(stderr, "Could not open the database: %m\n");
+		exit(EXIT_FAILURE);
+	}
+
+	struct loc_database* db;
+	err = loc_database_new(ctx, &db, f);
+	if (err) {
+		fprintf(stderr, "Could not load the database: %m\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// Check some well-known addresses
+	for (const char** s = addresses; *s; s++) {
+		err = loc_address_parse(&address, NULL, *s);
+		if (err) {
+			fprintf(stderr, "Could not parse %s\n", *s);
+			exit(EXIT_FAILURE);
+		}
+
+		err = compare(db, &address);
+		if (err)
+			exit(EXIT_FAILURE);
+	}
+
+	// Check that less specific networks are found
+	for (const struct fallback* fallback = fallbacks; fallback->address; fallback++) {
+		err = check_fallback(db, fallback);
+		if (err)
+			exit(EXIT_FAILURE);
+	}
+
+	// Use the same addresses every time
+	srandom(1);
+
+	// Check random addresses
+	for (unsigned int i = 0; i < TEST_ADDRESSES; i++) {
+		random_address(&address, (i % 2) ? AF_INET6 : AF_INET);
+
+		err = compare(db, &address);
+		if (err)
+			exit(EXIT_FAILURE);
+	}
+
+	// Check IPv4 lookups
+	for (unsigned int i = 0; i < TEST_ADDRESSES; i++) {
+		random_address(&address, AF_INET);
+
+		err = check_lookup4(db, &address);
+		if (err)
+			exit(EXIT_FAILURE);
+	}
+
+	err = check_without_ipv4(ctx);
+	if (err)
+		exit(EXIT_FAILURE);
+
+	// Check batch lookups with different batch sizes
+	const size_t batches[] = { 1, 7, 256, TEST_ADDRESSES, 0 };
+
+	for (const size_t* batch = batches; *batch; batch++) {
+		err = check_many(db, *batch);
+		if (err)
+			exit(EXIT_FAILURE);
+	}
+
+	// Check the cache with a couple of sizes
+	const size_t sizes[] = { 1, 100, 4096, 0 };
+
+	for (const size_t* size = sizes; *size; size++) {
+		err = check_cache(db, *size);
+		if (err)
+			exit(EXIT_FAILURE);
+	}
+
+	// Check invalid buckets
+	struct loc_database_cache* cache = NULL;
+
+	err = loc_database_cache_new(&cache, db, 0, 33, 48);
+	if (!err || errno != EINVAL)
+		exit(EXIT_FAILURE);
+
+	// Check the stride index
+	err = check_index(ctx, f, db, LOC_DB_INDEX_STRIDE, 0);
+	if (err)
+		exit(EXIT_FAILURE);
+
+	// Check the DIR-24-8 index
+	err = check_index(ctx, f, db, LOC_DB_INDEX_DIR24, 0);
+	if (err)
+		exit(EXIT_FAILURE);
+
+	// Check both together
+	err = check_index(ctx, f, db, LOC_DB_INDEX_STRIDE|LOC_DB_INDEX_DIR24, 0);
+	if (err)
+		exit(EXIT_FAILURE);
+
+	// Check a validated database without and with all indexes
+	err = check_index(ctx, f, db, 0, 1);
+	if (err)
+		exit(EXIT_FAILURE);
+
+	err = check_index(ctx, f, db, LOC_DB_INDEX_STRIDE|LOC_DB_INDEX_DIR24, 1);
+	if (err)
+		exit(EXIT_FAILURE);
+
+	// Check that damaged databases are not validated
+	err = check_validate(ctx);
+	if (err)
+		exit(EXIT_FAILURE);
+
+	// An empty batch does nothing
+	err = loc_database_lookup_many(db, NULL, 0, NULL);
+	if (err)
+		exit(EXIT_FAILURE);
+
+	loc_database_unref(db);
+	loc_unref(ctx);
+	fclose(f);
+
+	return EXIT_SUCCESS;
+}
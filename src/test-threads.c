@@ -0,0 +1,362 @@
+/*
+	libloc - A library to determine the location of someone on the Internet
+
+	Copyright (C) 2024 IPFire Development Team <info@ipfire.org>
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+*/
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libloc/libloc.h>
+#include <libloc/address.h>
+#include <libloc/as.h>
+#include <libloc/country.h>
+#include <libloc/country-list.h>
+#include <libloc/database.h>
+#include <libloc/network.h>
+
+#include "test.h"
+
+#define THREADS 8
+#define TEST_ADDRESSES 20000
+#define REFS 100000
+#define TEST_ASES 10000
+
+// The country whose networks every thread enumerates
+#define COUNTRY "LI"
+
+/*
+	Everything the threads share
+*/
+static struct loc_database* db = NULL;
+static struct loc_country_list* countries = NULL;
+static struct loc_network* shared_network = NULL;
+
+static struct in6_addr addresses[TEST_ADDRESSES];
+static struct loc_network_info expected[TEST_ADDRESSES];
+static char expected_strings[TEST_ADDRESSES][INET6_ADDRSTRLEN];
+static size_t expected_networks = 0;
+
+static int count_networks(size_t* count) {
+	struct loc_database_enumerator* enumerator = NULL;
+	struct loc_network* network = NULL;
+	int r;
+
+	*count = 0;
+
+	r = loc_database_enumerator_new(&enumerator, db, LOC_DB_ENUMERATE_NETWORKS, 0);
+	if (r) {
+		fprintf(stderr, "Could not create enumerator: %m\n");
+		return r;
+	}
+
+	r = loc_database_enumerator_set_countries(enumerator, countries);
+	if (r)
+		goto ERROR;
+
+	for (;;) {
+		r = loc_database_enumerator_next_network(enumerator, &network);
+		if (r) {
+			fprintf(stderr, "Could not fetch the next network: %m\n");
+			goto ERROR;
+		}
+
+		if (!network)
+			break;
+
+		if (strcmp(loc_network_get_country_code(network), COUNTRY) != 0) {
+			fprintf(stderr, "%s does not belong to %s\n", loc_network_str(network), COUNTRY);
+			r = 1;
+		}
+
+		loc_network_unref(network);
+		if (r)
+			goto ERROR;
+
+		(*count)++;
+	}
+
+ERROR:
+	loc_database_enumerator_unref(enumerator);
+
+	return r;
+}
+
+static int check_lookups(unsigned int offset) {
+	struct loc_network_info info;
+	struct loc_network* network = NULL;
+	int r;
+
+	for (unsigned int j = 0; j < TEST_ADDRESSES; j++) {
+		// Make the threads look up different addresses at the same time
+		unsigned int i = (offset + j) % TEST_ADDRESSES;
+
+		r = loc_database_lookup_info(db, &addresses[i], &info);
+		if (r) {
+			fprintf(stderr, "Could not look up %s: %m\n", expected_strings[i]);
+			return r;
+		}
+
+		if (!info_equal(&info, &expected[i])) {
+			fprintf(stderr, "Unexpected result for %s\n", expected_strings[i]);
+			return 1;
+		}
+
+		r = loc_database_lookup(db, &addresses[i], &network);
+		if (r) {
+			fprintf(stderr, "Could not look up %s: %m\n", expected_strings[i]);
+			return r;
+		}
+
+		if (!network != (expected[i].family == AF_UNSPEC)) {
+			fprintf(stderr, "Unexpected network for %s\n", expected_strings[i]);
+			r = 1;
+
+		} else if (network && loc_network_prefix(network) != expected[i].prefix) {
+			fprintf(stderr, "Unexpected prefix for %s\n", expected_strings[i]);
+			r = 1;
+		}
+
+		if (network)
+			loc_network_unref(network);
+
+		if (r)
+			return r;
+
+		// The formatting buffers must not be shared
+		if (strcmp(loc_address_str(&addresses[i]), expected_strings[i]) != 0) {
+			fprintf(stderr, "Could not format %s\n", expected_strings[i]);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+	Fetches the same ASes and countries from all threads at the same time
+	so that they are being shared while they are being created
+*/
+static int check_shared_objects(void) {
+	struct loc_country* country = NULL;
+	struct loc_as* as = NULL;
+	const char* name = NULL;
+	int r;
+
+	for (uint32_t number = 1; number <= TEST_ASES; number++) {
+		r = loc_database_get_as(db, &as, number);
+		if (r)
+			continue;
+
+		if (loc_as_get_number(as) != number) {
+			fprintf(stderr, "Got AS%u instead of AS%u\n", loc_as_get_number(as), number);
+			r = 1;
+		}
+
+		// The name must match the one in the database
+		else if (loc_database_get_as_name(db, number, &name)
+				|| strcmp(name, loc_as_get_name(as)) != 0) {
+			fprintf(stderr, "Got the wrong name for AS%u\n", number);
+			r = 1;
+		}
+
+		loc_as_unref(as);
+		if (r)
+			return r;
+	}
+
+	for (char cc[3] = "AA"; cc[0] <= 'W'; cc[0]++) {
+		for (cc[1] = 'A'; cc[1] <= 'Z'; cc[1]++) {
+			r = loc_database_get_country(db, &country, cc);
+			if (r) {
+				fprintf(stderr, "Could not fetch country %s: %m\n", cc);
+				return r;
+			}
+
+			if (!country)
+				continue;
+
+			if (strcmp(loc_country_get_code(country), cc) != 0) {
+				fprintf(stderr, "Got country %s instead of %s\n",
+					loc_country_get_code(country), cc);
+				r = 1;
+			}
+
+			loc_country_unref(country);
+			if (r)
+				return r;
+		}
+	}
+
+	return 0;
+}
+
+static void* worker(void* data) {
+	unsigned int offset = (unsigned int)(uintptr_t)data;
+	size_t count = 0;
+	int r;
+
+	r = check_lookups(offset);
+	if (r)
+		return (void*)1;
+
+	r = check_shared_objects();
+	if (r)
+		return (void*)1;
+
+	// Take and drop references to objects that all threads share
+	for (unsigned int i = 0; i < REFS; i++) {
+		loc_database_ref(db);
+		loc_network_ref(shared_network);
+
+		loc_network_unref(shared_network);
+		loc_database_unref(db);
+	}
+
+	r = count_networks(&count);
+	if (r)
+		return (void*)1;
+
+	if (count != expected_networks) {
+		fprintf(stderr, "Enumerated %zu networks, expected %zu\n", count, expected_networks);
+		return (void*)1;
+	}
+
+	return NULL;
+}
+
+static int run(const char* name) {
+	pthread_t threads[THREADS];
+	void* result = NULL;
+	int failed = 0;
+	int r;
+
+	printf("Running %d threads (%s)...\n", THREADS, name);
+
+	for (unsigned int i = 0; i < THREADS; i++) {
+		r = pthread_create(&threads[i], NULL, worker,
+			(void*)(uintptr_t)(i * TEST_ADDRESSES / THREADS));
+		if (r) {
+			fprintf(stderr, "Could not create thread: %s\n", strerror(r));
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	for (unsigned int i = 0; i < THREADS; i++) {
+		r = pthread_join(threads[i], &result);
+		if (r) {
+			fprintf(stderr, "Could not join thread: %s\n", strerror(r));
+			exit(EXIT_FAILURE);
+		}
+
+		if (result)
+			failed++;
+	}
+
+	return failed;
+}
+
+int main(int argc, char** argv) {
+	struct loc_country* country = NULL;
+	int r;
+
+	struct loc_ctx* ctx;
+	r = loc_new(&ctx);
+	if (r < 0)
+		exit(EXIT_FAILURE);
+
+	// Open the database
+	FILE* f = fopen(ABS_SRCDIR "/data/database.db", "r");
+	if (!f) {
+		fprintf(stderr, "Could not open file: %m\n");
+		exit(EXIT_FAILURE);
+	}
+
+	r = loc_database_new(ctx, &db, f);
+	if (r) {
+		fprintf(stderr, "Could not open database: %m\n");
+		exit(EXIT_FAILURE);
+	}
+
+	r = loc_country_list_new(ctx, &countries);
+	if (r)
+		exit(EXIT_FAILURE);
+
+	r = loc_country_new(ctx, &country, COUNTRY);
+	if (r)
+		exit(EXIT_FAILURE);
+
+	r = loc_country_list_append(countries, country);
+	if (r)
+		exit(EXIT_FAILURE);
+
+	loc_country_unref(country);
+
+	r = loc_network_new_from_string(ctx, &shared_network, "2001:db8::/32");
+	if (r)
+		exit(EXIT_FAILURE);
+
+	// Compute all results in a single thread first
+	for (unsigned int i = 0; i < TEST_ADDRESSES; i++) {
+		random_address(&addresses[i], (i % 2) ? AF_INET6 : AF_INET);
+
+		r = loc_database_lookup_info(db, &addresses[i], &expected[i]);
+		if (r) {
+			fprintf(stderr, "Could not look up %s: %m\n", loc_address_str(&addresses[i]));
+			exit(EXIT_FAILURE);
+		}
+
+		strcpy(expected_strings[i], loc_address_str(&addresses[i]));
+	}
+
+	r = count_networks(&expected_networks);
+	if (r)
+		exit(EXIT_FAILURE);
+
+	if (!expected_networks) {
+		fprintf(stderr, "Could not find any networks in %s\n", COUNTRY);
+		exit(EXIT_FAILURE);
+	}
+
+	if (run("tree"))
+		exit(EXIT_FAILURE);
+
+	// Repeat with a validated database and all indexes
+	r = loc_database_validate(db);
+	if (r) {
+		fprintf(stderr, "Could not validate the database: %m\n");
+		exit(EXIT_FAILURE);
+	}
+
+	r = loc_database_build_index(db, LOC_DB_INDEX_STRIDE|LOC_DB_INDEX_DIR24);
+	if (r) {
+		fprintf(stderr, "Could not build index: %m\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (run("indexed"))
+		exit(EXIT_FAILURE);
+
+	loc_network_unref(shared_network);
+	loc_country_list_unref(countries);
+	loc_database_unref(db);
+	loc_unref(ctx);
+	fclose(f);
+
+	return EXIT_SUCCESS;
+}
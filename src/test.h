@@ -0,0 +1,66 @@
+/*
+	libloc - A library to determine the location of someone on the Internet
+
+	Copyright (C) 2024 IPFire Development Team <info@ipfire.org>
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+*/
+
+#ifndef LIBLOC_TEST_H
+#define LIBLOC_TEST_H
+
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libloc/address.h>
+#include <libloc/network.h>
+
+/*
+	Helpers that are shared by the tests and benchmarks
+*/
+
+static inline void random_address(struct in6_addr* address, int family) {
+	for (unsigned int i = 0; i < 4; i++)
+		address->s6_addr32[i] = random();
+
+	switch (family) {
+		case AF_INET:
+			address->s6_addr32[0] = 0;
+			address->s6_addr32[1] = 0;
+			address->s6_addr32[2] = htonl(0xffff);
+			break;
+
+		// Global Unicast (2000::/3)
+		case AF_INET6:
+			address->s6_addr[0] = 0x20 | (address->s6_addr[0] & 0x1f);
+			break;
+	}
+}
+
+static inline int info_equal(const struct loc_network_info* info1,
+		const struct loc_network_info* info2) {
+	if (info1->family != info2->family)
+		return 0;
+
+	// Nothing else is set if nothing was found
+	if (info1->family == AF_UNSPEC)
+		return 1;
+
+	return info1->prefix == info2->prefix
+		&& loc_address_cmp(&info1->first_address, &info2->first_address) == 0
+		&& loc_address_cmp(&info1->last_address, &info2->last_address) == 0
+		&& strcmp(info1->country_code, info2->country_code) == 0
+		&& info1->asn == info2->asn
+		&& info1->flags == info2->flags;
+}
+
+#endif
@@ -16,6 +16,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -32,6 +33,7 @@
 #include <openssl/pem.h>
 
 #include <libloc/libloc.h>
+#include <libloc/address.h>
 #include <libloc/as.h>
 #include <libloc/as-list.h>
 #include <libloc/compat.h>
@@ -46,13 +48,16 @@
 
 struct loc_writer {
 	struct loc_ctx* ctx;
-	int refcount;
+	atomic_int refcount;
 
 	struct loc_stringpool* pool;
 	off_t vendor;
 	off_t description;
 	off_t license;
 
+	// Flags
+	int flags;
+
 	// Private keys to sign any databases
 	EVP_PKEY* private_key1;
 	EVP_PKEY* private_key2;
@@ -238,6 +243,12 @@ LOC_EXPORT int loc_writer_set_license(struct loc_writer* writer, const char* lic
 	return 0;
 }
 
+LOC_EXPORT int loc_writer_set_flags(struct loc_writer* writer, int flags) {
+	writer->flags = flags;
+
+	return 0;
+}
+
 LOC_EXPORT int loc_writer_add_as(struct loc_writer* writer, struct loc_as** as, uint32_t number) {
 	// Create a new AS object
 	int r = loc_as_new(writer->ctx, as, number);
@@ -388,8 +399,25 @@ static void free_network(struct network* network) {
 	free(network);
 }
 
+/*
+	All networks in the order in which they have been written
+*/
+struct written_networks {
+	struct loc_network** networks;
+	size_t count;
+};
+
+static void free_written_networks(struct written_networks* written) {
+	for (size_t i = 0; i < written->count; i++)
+		loc_network_unref(written->networks[i]);
+
+	if (written->networks)
+		free(written->networks);
+}
+
 static int loc_database_write_networks(struct loc_writer* writer,
-		struct loc_database_header_v1* header, off_t* offset, FILE* f) {
+		struct loc_database_header_v1* header, off_t* offset, FILE* f,
+		struct written_networks* written) {
 	int r;
 
 	// Write the network tree
@@ -497,6 +525,13 @@ static int loc_database_write_networks(struct loc_writer* writer,
 	DEBUG(writer->ctx, "Networks data section starts at %jd bytes\n", (intmax_t)*offset);
 	header->network_data_offset = htobe32(*offset);
 
+	// Keep all networks for the indexes
+	if (written && network_index) {
+		written->networks = calloc(network_index, sizeof(*written->networks));
+		if (!written->networks)
+			return 1;
+	}
+
 	// We have now written the entire tree and have all networks
 	// in a queue in order as they are indexed
 	while (!TAILQ_EMPTY(&networks)) {
@@ -511,6 +546,9 @@ static int loc_database_write_networks(struct loc_writer* writer,
 		*offset += fwrite(&db_network, 1, sizeof(db_network), f);
 		network_data_length += sizeof(db_network);
 
+		if (written)
+			written->networks[written->count++] = loc_network_ref(nw->network);
+
 		free_network(nw);
 	}
 
@@ -521,6 +559,315 @@ static int loc_database_write_networks(struct loc_writer* writer,
 	return 0;
 }
 
+struct indexed_network {
+	uint32_t key;
+	uint32_t index;
+	struct in6_addr address;
+	unsigned int prefix;
+};
+
+static int indexed_network_cmp(const void* p1, const void* p2) {
+	const struct indexed_network* n1 = p1;
+	const struct indexed_network* n2 = p2;
+	int r;
+
+	if (n1->key != n2->key)
+		return (n1->key < n2->key) ? -1 : 1;
+
+	// Sort by address and put larger networks first like the tree does
+	r = loc_address_cmp(&n1->address, &n2->address);
+	if (r)
+		return r;
+
+	return (int)n1->prefix - (int)n2->prefix;
+}
+
+/*
+	Writes a network index (see struct loc_database_network_index_v1) which
+	lists all networks for each key
+*/
+static int loc_database_write_network_index(struct loc_writer* writer,
+		struct indexed_network* networks, size_t count,
+		uint32_t* section_offset, uint32_t* section_length, off_t* offset, FILE* f) {
+	size_t length = 0;
+	size_t keys = 0;
+
+	*section_offset = 0;
+	*section_length = 0;
+
+	// Don't write anything if there are no networks
+	if (!count)
+		return 0;
+
+	qsort(networks, count, sizeof(*networks), indexed_network_cmp);
+
+	// Count the keys
+	for (size_t i = 0; i < count; i++) {
+		if (!i || networks[i].key != networks[i - 1].key)
+			keys++;
+	}
+
+	*section_offset = htobe32(*offset);
+
+	// Write the header
+	struct loc_database_network_index_v1 header = {
+		.keys     = htobe32(keys),
+		.networks = htobe32(count),
+	};
+
+	length += fwrite(&header, 1, sizeof(header), f);
+
+	// Write all keys
+	struct loc_database_network_index_key_v1 db_key;
+
+	for (size_t first = 0, i = 1; i <= count; i++) {
+		if (i < count && networks[i].key == networks[first].key)
+			continue;
+
+		db_key.key   = htobe32(networks[first].key);
+		db_key.first = htobe32(first);
+		db_key.count = htobe32(i - first);
+
+		length += fwrite(&db_key, 1, sizeof(db_key), f);
+
+		first = i;
+	}
+
+	// Write all networks
+	struct loc_database_network_index_entry_v1 db_entry;
+
+	memset(&db_entry, 0, sizeof(db_entry));
+
+	for (size_t i = 0; i < count; i++) {
+		memcpy(db_entry.address, &networks[i].address, sizeof(db_entry.address));
+		db_entry.prefix  = networks[i].prefix;
+		db_entry.network = htobe32(networks[i].index);
+
+		length += fwrite(&db_entry, 1, sizeof(db_entry), f);
+	}
+
+	DEBUG(writer->ctx, "Network index with %zu key(s) has a length of %zu bytes\n",
+		keys, length);
+
+	*offset += length;
+	*section_length = htobe32(length);
+
+	align_page_boundary(offset, f);
+
+	return 0;
+}
+
+static int loc_database_write_as_networks(struct loc_writer* writer,
+		struct loc_database_header_v1* header, const struct written_networks* written,
+		off_t* offset, FILE* f) {
+	struct indexed_network* networks = NULL;
+	int r;
+
+	DEBUG(writer->ctx, "AS networks section starts at %jd bytes\n", (intmax_t)*offset);
+
+	if (written->count) {
+		networks = calloc(written->count, sizeof(*networks));
+		if (!networks)
+			return 1;
+	}
+
+	for (size_t i = 0; i < written->count; i++) {
+		networks[i].key     = loc_network_get_asn(written->networks[i]);
+		networks[i].index   = i;
+		networks[i].address = *loc_network_get_first_address(written->networks[i]);
+		networks[i].prefix  = loc_network_raw_prefix(written->networks[i]);
+	}
+
+	r = loc_database_write_network_index(writer, networks, written->count,
+		&header->as_networks_offset, &header->as_networks_length, offset, f);
+
+	if (networks)
+		free(networks);
+
+	return r;
+}
+
+/*
+	A network that encloses the current position while flattening
+*/
+struct flat_network {
+	struct in6_addr last_address;
+
+	// The next address that is not part of a subnet
+	struct in6_addr next_address;
+	int exhausted;
+
+	uint32_t key;
+	uint32_t index;
+};
+
+/*
+	Splits the space from the next address of a network up to last_address
+	into as few networks as possible and appends them to parts
+*/
+static int loc_database_flatten_gap(const struct flat_network* flat,
+		const struct in6_addr* last_address,
+		struct indexed_network** parts, size_t* parts_count, size_t* parts_size) {
+	struct in6_addr first_address = flat->next_address;
+	struct in6_addr block_last_address;
+
+	// Networks without a country are not indexed
+	if (flat->exhausted || !flat->key)
+		return 0;
+
+	while (loc_address_cmp(&first_address, last_address) <= 0) {
+		// Make space
+		if (*parts_count == *parts_size) {
+			size_t parts_size_new = (*parts_size) ? *parts_size * 2 : 1024;
+
+			struct indexed_network* p = reallocarray(*parts, parts_size_new, sizeof(**parts));
+			if (!p)
+				return 1;
+
+			*parts = p;
+			*parts_size = parts_size_new;
+		}
+
+		struct indexed_network* part = &(*parts)[(*parts_count)++];
+
+		part->key     = flat->key;
+		part->index   = flat->index;
+		part->address = first_address;
+		part->prefix  = loc_address_largest_block(&first_address, last_address,
+			&block_last_address);
+
+		// Has the gap been filled?
+		if (loc_address_cmp(&block_last_address, last_address) == 0)
+			break;
+
+		first_address = block_last_address;
+		loc_address_increment(&first_address);
+	}
+
+	return 0;
+}
+
+/*
+	Writes the flattened networks of each country
+
+	This works like the flattening enumerator: all networks that enclose the
+	current position are kept on a stack, and whenever a subnet starts or an
+	enclosing network ends, the space in between is split into as few networks
+	as possible.
+*/
+static int loc_database_write_country_networks(struct loc_writer* writer,
+		struct loc_database_header_v1* header, const struct written_networks* written,
+		off_t* offset, FILE* f) {
+	struct flat_network stack[LOC_DATABASE_MAX_NESTING];
+	struct indexed_network* networks = NULL;
+	struct indexed_network* parts = NULL;
+	struct flat_network* flat = NULL;
+	struct in6_addr first_address;
+	struct in6_addr last_address;
+	struct in6_addr bitmask;
+	unsigned int depth = 0;
+	size_t parts_count = 0;
+	size_t parts_size = 0;
+	int r = 0;
+
+	DEBUG(writer->ctx, "Country networks section starts at %jd bytes\n", (intmax_t)*offset);
+
+	if (written->count) {
+		networks = calloc(written->count, sizeof(*networks));
+		if (!networks)
+			return 1;
+	}
+
+	// Sort all networks by their addresses
+	for (size_t i = 0; i < written->count; i++) {
+		networks[i].index   = i;
+		networks[i].address = *loc_network_get_first_address(written->networks[i]);
+		networks[i].prefix  = loc_network_raw_prefix(written->networks[i]);
+	}
+
+	qsort(networks, written->count, sizeof(*networks), indexed_network_cmp);
+
+	for (size_t i = 0; i <= written->count;) {
+		const int end = (i == written->count);
+
+		if (!end) {
+			bitmask = loc_prefix_to_bitmask(networks[i].prefix);
+
+			first_address = networks[i].address;
+			last_address  = loc_address_or(&first_address, &bitmask);
+		}
+
+		if (depth) {
+			flat = &stack[depth - 1];
+
+			// If the next network is not a subnet, the enclosing network ends here
+			if (end || loc_address_cmp(&first_address, &flat->last_address) > 0) {
+				r = loc_database_flatten_gap(flat, &flat->last_address,
+					&parts, &parts_count, &parts_size);
+				if (r)
+					goto ERROR;
+
+				depth--;
+				continue;
+			}
+
+			// Otherwise split everything up to the start of the subnet
+			if (loc_address_cmp(&flat->next_address, &first_address) < 0) {
+				struct in6_addr gap_last_address = first_address;
+				loc_address_decrement(&gap_last_address);
+
+				r = loc_database_flatten_gap(flat, &gap_last_address,
+					&parts, &parts_count, &parts_size);
+				if (r)
+					goto ERROR;
+			}
+
+			// Everything else in this subnet will be handled by the subnet
+			if (loc_address_cmp(&last_address, &flat->last_address) == 0) {
+				flat->exhausted = 1;
+			} else {
+				flat->next_address = last_address;
+				loc_address_increment(&flat->next_address);
+			}
+		}
+
+		if (end)
+			break;
+
+		// The tree cannot nest networks any deeper than their prefix
+		if (depth >= LOC_DATABASE_MAX_NESTING) {
+			ERROR(writer->ctx, "Networks are nested too deeply\n");
+			errno = EINVAL;
+			r = 1;
+			goto ERROR;
+		}
+
+		const char* country_code = loc_network_get_country_code(
+			written->networks[networks[i].index]);
+
+		flat = &stack[depth++];
+
+		flat->last_address = last_address;
+		flat->next_address = first_address;
+		flat->exhausted    = 0;
+		flat->key          = (*country_code) ? LOC_DATABASE_COUNTRY_KEY(country_code) : 0;
+		flat->index        = networks[i].index;
+
+		i++;
+	}
+
+	r = loc_database_write_network_index(writer, parts, parts_count,
+		&header->country_networks_offset, &header->country_networks_length, offset, f);
+
+ERROR:
+	if (parts)
+		free(parts);
+	if (networks)
+		free(networks);
+
+	return r;
+}
+
 static int loc_database_write_countries(struct loc_writer* writer,
 		struct loc_database_header_v1* header, off_t* offset, FILE* f) {
 	DEBUG(writer->ctx, "Countries section starts at %jd bytes\n", (intmax_t)*offset);
@@ -643,6 +990,7 @@ END:
 }
 
 LOC_EXPORT int loc_writer_write(struct loc_writer* writer, FILE* f, enum loc_database_version version) {
+	struct written_networks written = { NULL, 0 };
 	size_t bytes_written = 0;
 
 	// Check version
@@ -679,6 +1027,12 @@ LOC_EXPORT int loc_writer_write(struct loc_writer* writer, FILE* f, enum loc_dat
 	memset(header.signature2, '\0', sizeof(header.signature2));
 	header.signature2_length = 0;
 
+	// Clear the optional indexes
+	header.as_networks_offset      = 0;
+	header.as_networks_length      = 0;
+	header.country_networks_offset = 0;
+	header.country_networks_length = 0;
+
 	// Clear the padding
 	memset(header.padding, '\0', sizeof(header.padding));
 
@@ -708,10 +1062,28 @@ LOC_EXPORT int loc_writer_write(struct loc_writer* writer, FILE* f, enum loc_dat
 	if (r)
 		return r;
 
-	// Write all networks
-	r = loc_database_write_networks(writer, &header, &offset, f);
+	// Write all networks and only keep them if any index needs them
+	r = loc_database_write_networks(writer, &header, &offset, f,
+		(writer->flags & (LOC_WRITER_INDEX_AS_NETWORKS|LOC_WRITER_INDEX_COUNTRY_NETWORKS)) ?
+			&written : NULL);
 	if (r)
-		return r;
+		goto ERROR;
+
+	// Write the networks of each AS
+	if (writer->flags & LOC_WRITER_INDEX_AS_NETWORKS) {
+		r = loc_database_write_as_networks(writer, &header, &written, &offset, f);
+		if (r)
+			goto ERROR;
+	}
+
+	// Write the networks of each country
+	if (writer->flags & LOC_WRITER_INDEX_COUNTRY_NETWORKS) {
+		r = loc_database_write_country_networks(writer, &header, &written, &offset, f);
+		if (r)
+			goto ERROR;
+	}
+
+	free_written_networks(&written);
 
 	// Write countries
 	r = loc_database_write_countries(writer, &header, &offset, f);
@@ -782,5 +1154,10 @@ LOC_EXPORT int loc_writer_write(struct loc_writer* writer, FILE* f, enum loc_dat
 	// Flush everything
 	fflush(f);
 
+	return r;
+
+ERROR:
+	free_written_networks(&written);
+
 	return r;
 }
@@ -0,0 +1,104 @@
+#!/usr/bin/python3
+###############################################################################
+#                                                                             #
+# libloc - A library to determine the location of someone on the Internet     #
+#                                                                             #
+# Copyright (C) 2026 IPFire Development Team <info@ipfire.org>                #
+#                                                                             #
+# This library is free software; you can redistribute it and/or               #
+# modify it under the terms of the GNU Lesser General Public                  #
+# License as published by the Free Software Foundation; either                #
+# version 2.1 of the License, or (at your option) any later version.          #
+#                                                                             #
+# This library is distributed in the hope that it will be useful,             #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of              #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU           #
+# Lesser General Public License for more details.                             #
+#                                                                             #
+###############################################################################
+
+import location
+import os
+import tempfile
+import unittest
+
+NETWORKS = (
+	("10.0.0.0/8",     "DE", 204867),
+	("10.1.0.0/16",    "GB", 204867),
+	("10.2.0.0/16",    "DE", 65536),
+	("192.0.2.0/24",   "FR", 65536),
+	("2001:db8::/32",  "DE", 204867),
+	("2001:db8::/48",  "FR", 65537),
+)
+
+class Test(unittest.TestCase):
+	def setUp(self):
+		# Show even very large diffs
+		self.maxDiff = None
+
+	def __write(self, path, flags=0):
+		"""
+			Writes all test networks into a database with the given flags
+		"""
+		w = location.Writer()
+		w.set_flags(flags)
+
+		for network, cc, asn in NETWORKS:
+			n = w.add_network(network)
+			n.country_code = cc
+			n.asn = asn
+
+		w.write(path)
+
+		return location.Database(path)
+
+	def __search(self, db, **kwargs):
+		return ["%s" % network for network in db.search_networks(**kwargs)]
+
+	def test_index_as_networks(self):
+		"""
+			Writes a database with the networks of each AS and reads them back
+		"""
+		with tempfile.NamedTemporaryFile() as f1, tempfile.NamedTemporaryFile() as f2:
+			db = self.__write(f1.name)
+			indexed = self.__write(f2.name, location.WRITER_INDEX_AS_NETWORKS)
+
+			# The index must have been written
+			self.assertGreater(os.path.getsize(f2.name), os.path.getsize(f1.name))
+
+			for asns in ([204867], [65536], [65537], [65536, 204867], [1]):
+				expected = [network for network, cc, asn in NETWORKS if asn in asns]
+
+				self.assertCountEqual(self.__search(indexed, asns=asns), expected)
+				self.assertCountEqual(self.__search(db, asns=asns), expected)
+
+	def test_index_country_networks(self):
+		"""
+			Writes a database with the flattened networks of each country and reads them back
+		"""
+		with tempfile.NamedTemporaryFile() as f1, tempfile.NamedTemporaryFile() as f2:
+			db = self.__write(f1.name)
+			indexed = self.__write(f2.name, location.WRITER_INDEX_COUNTRY_NETWORKS)
+
+			# The index must have been written
+			self.assertGreater(os.path.getsize(f2.name), os.path.getsize(f1.name))
+
+			for country_codes, expected in (
+				(["DE"], ["10.0.0.0/16", "10.2.0.0/16", "10.3.0.0/16", "10.4.0.0/14", "10.8.0.0/13",
+					"10.16.0.0/12", "10.32.0.0/11", "10.64.0.0/10", "10.128.0.0/9",
+					"2001:db8:1::/48", "2001:db8:2::/47", "2001:db8:4::/46", "2001:db8:8::/45",
+					"2001:db8:10::/44", "2001:db8:20::/43", "2001:db8:40::/42",
+					"2001:db8:80::/41", "2001:db8:100::/40", "2001:db8:200::/39",
+					"2001:db8:400::/38", "2001:db8:800::/37", "2001:db8:1000::/36",
+					"2001:db8:2000::/35", "2001:db8:4000::/34", "2001:db8:8000::/33"]),
+				(["GB"], ["10.1.0.0/16"]),
+				(["FR"], ["192.0.2.0/24", "2001:db8::/48"]),
+				(["US"], []),
+			):
+				self.assertCountEqual(
+					self.__search(indexed, country_codes=country_codes, flatten=True), expected)
+				self.assertCountEqual(
+					self.__search(db, country_codes=country_codes, flatten=True), expected)
+
+if __name__ == "__main__":
+	unittest.main()